@@ -26,14 +26,25 @@
 #ifndef _EXOSTRA_H_INCLUDED
 # define _EXOSTRA_H_INCLUDED
 
+# include <cstddef>
 # include <cstdint>
+# include <climits>
 # include <functional>
 # include <type_traits>
 # include <string>
+# include <string_view>
 # include <memory>
+# include <optional>
 # include <array>
+# include <vector>
+# include <algorithm>
+# include <cstring>
 # include <queue>
 # include <mutex>
+# if defined(EWM_ASYNC_FLUSH)
+#  include <thread>
+#  include <condition_variable>
+# endif
 
 // TODO: remove me
 # define EWM_COLOR_565
@@ -51,7 +62,180 @@
 
 // Enabled logging level (setting to any level except EWM_LOG_LEVEL_NONE increases
 // the resulting binary size substantially!).
-# define EWM_LOG_LEVEL EWM_LOG_LEVEL_VERBOSE //EWM_LOG_LEVEL_NONE
+# if !defined(EWM_LOG_LEVEL)
+#  define EWM_LOG_LEVEL EWM_LOG_LEVEL_VERBOSE //EWM_LOG_LEVEL_NONE
+# endif
+
+// Maximum number of disjoint dirty rects tracked per window. Once exceeded, the
+// pair of rects that is cheapest to combine is merged into its bounding box.
+# if !defined(EWM_MAX_DIRTY_RECTS)
+#  define EWM_MAX_DIRTY_RECTS 4
+# endif
+
+// Number of wasted pixels considered cheaper to flush than the overhead of an
+// additional transfer (e.g. an SPI address window); adjacent dirty rects whose
+// bounding box wastes no more than this are merged eagerly.
+# if !defined(EWM_DIRTY_MERGE_SLACK_PX)
+#  define EWM_DIRTY_MERGE_SLACK_PX 256
+# endif
+
+// Maximum number of rects in a Region (e.g. the visible area of a top-level window).
+// Should a result exceed this, the excess is folded into the last rect (erring on
+// the side of flushing too much) and a warning is logged.
+# if !defined(EWM_MAX_REGION_RECTS)
+#  define EWM_MAX_REGION_RECTS 32
+# endif
+
+// Enables the asynchronous flush pipeline: render() queues the rects to be flushed,
+// and a worker thread transfers them to the display while the next frame is being
+// composed. Requires std::thread (pthreads on ESP-IDF).
+//# define EWM_ASYNC_FLUSH
+
+// Maximum number of rects queued for transfer to the display at any one time.
+# if !defined(EWM_FLUSH_QUEUE_DEPTH)
+#  define EWM_FLUSH_QUEUE_DEPTH 16
+# endif
+
+// Draws into Exostra's own 565 canvas (Canvas16) rather than the graphics library's
+// (GFXcanvas16 or Arduino_Canvas), so that drawing does not depend on it; the library
+// is then only used to talk to the display. Only GFXfont fonts are drawn. Always the
+// case with EWM_GFX_FBDEV.
+//# define EWM_NATIVE_CANVAS
+
+// Disables the vectorized (SSE2, NEON or PIE) pixel kernels (see PixelKernels),
+// leaving the scalar ones.
+//# define EWM_NO_SIMD
+
+// Enables the fill and byte-swap kernels that use the ESP32-S3's PIE (SIMD)
+// instructions. Like the others, they are checked against the scalar kernels on first
+// use, and only used if they produce the same pixels. With an Adafruit SPI display,
+// pixels are then byte-swapped by the kernel rather than by the library.
+//# define EWM_SIMD_PIE
+# if !defined(EWM_NO_SIMD)
+#  if defined(__SSE2__)
+#   include <emmintrin.h>
+#   define EWM_SIMD_SSE2
+#   undef EWM_SIMD_PIE
+#  elif defined(__ARM_NEON)
+#   include <arm_neon.h>
+#   define EWM_SIMD_NEON
+#   undef EWM_SIMD_PIE
+#  elif defined(EWM_SIMD_PIE) && !defined(__XTENSA__)
+#   error "EWM_SIMD_PIE requires an ESP32-S3"
+#  endif
+# else
+#  undef EWM_SIMD_PIE
+# endif
+
+// Default cost model of transfers to the display (see FlushCost): the fixed overhead
+// of a transaction (in microseconds), and the throughput (in bytes per microsecond).
+// WindowManager::Config::calibrateFlush measures both when begin() is called.
+# if !defined(EWM_FLUSH_OVERHEAD_US)
+#  if defined(EWM_GFX_FBDEV)
+#   define EWM_FLUSH_OVERHEAD_US 0.5f
+#  else
+#   define EWM_FLUSH_OVERHEAD_US 10.0f
+#  endif
+# endif
+# if !defined(EWM_FLUSH_BYTES_PER_US)
+#  if defined(EWM_GFX_FBDEV)
+#   define EWM_FLUSH_BYTES_PER_US 1000.0f
+#  else
+#   define EWM_FLUSH_BYTES_PER_US 5.0f
+#  endif
+# endif
+
+// Rects transferred to the display are widened to multiples of this many pixels
+// where that does not send anything it should not (e.g. 2 for 32-bit aligned DMA).
+# if !defined(EWM_FLUSH_ALIGN)
+#  define EWM_FLUSH_ALIGN 2
+# endif
+
+// Height (in lines) of the strip buffer used by RenderMode::Banded, unless otherwise
+// specified by WindowManager::Config::bandHeight.
+# if !defined(EWM_BAND_HEIGHT)
+#  define EWM_BAND_HEIGHT 24
+# endif
+
+// Width and height (in pixels) of the tiles that the display is divided into when
+// WindowManager::Config::tileHash is set.
+# if !defined(EWM_TILE_SIZE)
+#  define EWM_TILE_SIZE 16
+# endif
+
+// Largest corner radius that Canvas16 rasterizes as spans (caching the shape of the
+// arc); rounded rects with larger corners are drawn a pixel at a time.
+# if !defined(EWM_MAX_ARC_RADIUS)
+#  define EWM_MAX_ARC_RADIUS 64
+# endif
+
+// Number of characters (including the terminator) of window text that are stored
+// inline in the window; longer text is stored on the heap.
+# if !defined(EWM_TEXT_INLINE_SIZE)
+#  define EWM_TEXT_INLINE_SIZE 32
+# endif
+
+// Number of bits of a WindowHandle that select a slot in the handle table; the
+// maximum number of live windows is (2^EWM_HANDLE_INDEX_BITS) - 1. The rest of the
+// bits count the reuse of each slot, and wrap around. Every slot is used before any
+// is reused (oldest first), so a stale handle can only resolve to another window
+// once slots * (2^(16 - EWM_HANDLE_INDEX_BITS) - 1) windows have been created since;
+// slots is the live window maximum, or EWM_POOL_WINDOWS with EWM_STATIC_POOLS. So
+// more index bits allow more live windows, but fewer generations per slot.
+# if !defined(EWM_HANDLE_INDEX_BITS)
+#  define EWM_HANDLE_INDEX_BITS 10
+# endif
+
+// Allocates the window manager, windows, child lists, message queues and off-screen
+// buffers from pools that are sized at compile time, so that nothing is allocated
+// from the heap once WindowManager::begin() has returned. Pool exhaustion is reported
+// as a failure by createWindow()/begin(). RenderMode::Retained is unavailable (each
+// top-level window would need its own canvas), and window text is truncated to
+// EWM_TEXT_INLINE_SIZE. Logging at EWM_LOG_LEVEL_DEBUG and above still allocates.
+//# define EWM_STATIC_POOLS
+
+# if defined(EWM_STATIC_POOLS)
+// Maximum number of live windows.
+#  if !defined(EWM_POOL_WINDOWS)
+#   define EWM_POOL_WINDOWS 32
+#  endif
+// Number of drawing primitives that each window can record into its display list
+// (see DisplayList); zero disables display lists.
+#  if !defined(EWM_POOL_DISPLAY_LIST)
+#   define EWM_POOL_DISPLAY_LIST 0
+#  endif
+// Size (in bytes) of each block in the window pool; must hold the largest window
+// class plus its reference count.
+#  if !defined(EWM_POOL_WINDOW_SIZE)
+#   define EWM_POOL_WINDOW_SIZE (1024 + (EWM_POOL_DISPLAY_LIST * 16))
+#  endif
+// Maximum number of children per window (and of top-level windows).
+#  if !defined(EWM_POOL_CHILDREN)
+#   define EWM_POOL_CHILDREN 16
+#  endif
+// Maximum number of messages queued per window.
+#  if !defined(EWM_POOL_MESSAGES)
+#   define EWM_POOL_MESSAGES 8
+#  endif
+// Number of tiles reserved for WindowManager::Config::tileHash; the display needs
+// (width / EWM_TILE_SIZE) * (height / EWM_TILE_SIZE), rounded up. Zero disables it.
+#  if !defined(EWM_POOL_TILES)
+#   define EWM_POOL_TILES 0
+#  endif
+// Size (in bytes) of the block that holds the window manager.
+#  if !defined(EWM_POOL_WM_SIZE)
+#   define EWM_POOL_WM_SIZE (8192 + (EWM_POOL_TILES * 4))
+#  endif
+// Number of 16-bit pixels reserved for off-screen buffers (the RenderMode::Shared
+// buffer, or the RenderMode::Banded strip(s)).
+#  if !defined(EWM_POOL_PIXELS)
+#   define EWM_POOL_PIXELS (480 * EWM_BAND_HEIGHT * 2)
+#  endif
+// Attribute(s) applied to the pixel pool, e.g. EXT_RAM_BSS_ATTR to place it in PSRAM.
+#  if !defined(EWM_POOL_PIXELS_ATTR)
+#   define EWM_POOL_PIXELS_ATTR
+#  endif
+# endif
 
 // Enables runtime assertions. Upon a failed assertion, prints the expression that
 // evaluated to false, as well as the backtrace leading up to the failed assertion
@@ -69,7 +253,7 @@
     }); \
     esp_backtrace_print(EWM_BACKTRACE_FRAMES)
 # else
-#  define print_backtrace
+#  define print_backtrace()
 # endif
 
 # if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
@@ -151,7 +335,9 @@
 #   endif
     using IGfxDisplay = Adafruit_SPITFT;
 #  endif
+#  if !defined(EWM_NATIVE_CANVAS)
     using IGfxContext16 = GFXcanvas16;
+#  endif
 #  if defined(__AVR__)
 #   include <avr/pgmspace.h>
 #  elif defined(ESP32) || defined(ESP8266)
@@ -184,22 +370,134 @@
 #  endif
 #  if defined(ATTINY_CORE)
 #   error "required GFXfont implementation unavailable due to ATTINY_CORE"
+#  endif
+#  if defined(CONFIG_IDF_TARGET_ESP32S3) && __has_include(<esp32s3/rom/cache.h>)
+#   include <esp32s3/rom/cache.h>
+#   define EWM_HAVE_ROM_CACHE
 #  endif
     using IGfxDisplay   = Arduino_RGB_Display;
+#  if !defined(EWM_NATIVE_CANVAS)
     using IGfxContext16 = Arduino_Canvas;
+#  endif
+# elif defined(EWM_GFX_FBDEV)
+#  if !defined(__linux__)
+#   error "EWM_GFX_FBDEV is only available on Linux"
+#  endif
+#  include <cerrno>
+#  include <cstdio>
+#  include <cstdlib>
+#  include <cstring>
+#  include <cmath>
+#  include <chrono>
+#  include <deque>
+#  include <algorithm>
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/ioctl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <linux/fb.h>
+#  if !defined(PROGMEM)
+#   define PROGMEM
+#  endif
+#  if !defined(pgm_read_byte)
+#   define pgm_read_byte(addr) (*(reinterpret_cast<const uint8_t*>(addr)))
+#  endif
+#  if !defined(pgm_read_word)
+#   define pgm_read_word(addr) (*(reinterpret_cast<const uint16_t*>(addr)))
+#  endif
+// Layout-compatible with Adafruit GFX's gfxfont.h, so that the fonts shipped with
+// Adafruit GFX (e.g. Fonts/FreeSans12pt7b.h) may be used as-is.
+#  if !defined(_GFXFONT_H_)
+#   define _GFXFONT_H_
+    typedef struct
+    {
+        uint16_t bitmapOffset; /**< Offset into GFXfont->bitmap. */
+        uint8_t width;         /**< Bitmap dimensions in pixels. */
+        uint8_t height;        /**< Bitmap dimensions in pixels. */
+        uint8_t xAdvance;      /**< Distance to advance cursor (x axis). */
+        int8_t xOffset;        /**< X dist from cursor pos to UL corner. */
+        int8_t yOffset;        /**< Y dist from cursor pos to UL corner. */
+    } GFXglyph;
+
+    typedef struct
+    {
+        uint8_t* bitmap;       /**< Glyph bitmaps, concatenated. */
+        GFXglyph* glyph;       /**< Glyph array. */
+        uint16_t first;        /**< ASCII extents (first char). */
+        uint16_t last;         /**< ASCII extents (last char). */
+        uint8_t yAdvance;      /**< Newline distance (y axis). */
+    } GFXfont;
+#  endif
+    namespace exostra
+    {
+        class FbDisplay;
+    } // namespace exostra
+    using IGfxDisplay = exostra::FbDisplay;
+#  if !defined(EWM_NATIVE_CANVAS)
+#   define EWM_NATIVE_CANVAS
+#  endif
 # else
-#  error "define EWM_GFX_ADAFRUIT or EWM_GFX_ARDUINO, and install the relevant \
-library in order to select a low-level graphics driver"
+#  error "define EWM_GFX_ADAFRUIT, EWM_GFX_ARDUINO, or EWM_GFX_FBDEV, and install the \
+relevant library (if any) in order to select a low-level graphics driver"
+# endif
+
+# if defined(EWM_NATIVE_CANVAS)
+#  if defined(__AVR__)
+#   error "EWM_NATIVE_CANVAS is unavailable on AVR (fonts in PROGMEM)"
+#  endif
+    namespace exostra
+    {
+        class Canvas16;
+    } // namespace exostra
+    using IGfxContext16 = exostra::Canvas16;
 # endif
 
 namespace exostra
 {
-    /** Window identifier. */
-    using WindowID = uint8_t;
+# if defined(EWM_GFX_FBDEV)
+    using std::min;
+    using std::max;
+    using std::abs;
+
+    /** Milliseconds elapsed since the first call (Arduino's millis()). */
+    inline uint32_t millis()
+    {
+        using namespace std::chrono;
+        static const auto epoch = steady_clock::now();
+        return static_cast<uint32_t>(
+            duration_cast<milliseconds>(steady_clock::now() - epoch).count()
+        );
+    }
+
+    /** Microseconds elapsed since the first call (Arduino's micros()). */
+    inline uint32_t micros()
+    {
+        using namespace std::chrono;
+        static const auto epoch = steady_clock::now();
+        return static_cast<uint32_t>(
+            duration_cast<microseconds>(steady_clock::now() - epoch).count()
+        );
+    }
+# endif
+
+    /** Window identifier (assigned by the application; unique among siblings). */
+    using WindowID = uint16_t;
 
     /** Represents an invalid window identifier. */
     EWM_CONST(WindowID, WID_INVALID, 0);
 
+    /**
+     * Window handle (assigned by the window manager; unique among all live windows).
+     * The low EWM_HANDLE_INDEX_BITS bits are a slot in the handle table, and the
+     * remaining bits are a generation count, so handles to destroyed windows are
+     * detected rather than resolved to whichever window reused the slot.
+     */
+    using WindowHandle = uint16_t;
+
+    /** Represents an invalid window handle. */
+    EWM_CONST(WindowHandle, WH_INVALID, 0);
+
     /** Window message parameter type. */
     using MsgParam = uint32_t;
 
@@ -313,6 +611,14 @@ namespace exostra
             bottom -= px;
         }
 
+        void offset(Coord dx, Coord dy) noexcept
+        {
+            left   += dx;
+            top    += dy;
+            right  += dx;
+            bottom += dy;
+        }
+
         bool overlapsRect(const Rect& other) const noexcept
         {
             if ((top >= other.top && top <= other.bottom) ||
@@ -367,108 +673,28 @@ namespace exostra
         std::queue<Rect> subtractRect(const Rect& other) const
         {
             std::queue<Rect> rects;
-            if (intersectsRect(other)) {
-                auto mergedRect = *this;
-                mergedRect.mergeRect(other);
-                const auto alignedLeft   = mergedRect.left   >= other.left;
-                const auto alignedTop    = mergedRect.top    >= other.top;
-                const auto alignedRight  = mergedRect.right  <= other.right;
-                const auto alignedBottom = mergedRect.bottom <= other.bottom;
-                if (!alignedLeft || !alignedTop || !alignedRight || !alignedBottom) {
-                    const auto topNoAlignTop       = max(mergedRect.top, top);
-                    const auto topNoAlignBottom    = min(mergedRect.bottom, other.bottom);
-                    const auto bottomNoAlignTop    = min(mergedRect.bottom, other.top);
-                    const auto bottomNoAlignBottom = min(mergedRect.bottom, bottom);
-                    const auto leftNoAlignRight    = min(mergedRect.right, other.right);
-                    const auto leftNoAlignLeft     = max(mergedRect.left, left);
-                    const auto rightNoAlignRight   = min(mergedRect.right, right);
-                    const auto rightNoAlignLeft    = max(mergedRect.left, other.left);
-                    if (alignedLeft || alignedRight) {
-                        if (alignedLeft && !alignedRight) {
-                            rects.emplace(
-                                leftNoAlignRight,
-                                max(mergedRect.top, top),
-                                rightNoAlignRight,
-                                min(mergedRect.bottom, bottom)
-                            );
-                        }
-                        if (alignedRight && !alignedLeft) {
-                            rects.emplace(
-                                leftNoAlignLeft,
-                                max(mergedRect.top, top),
-                                rightNoAlignLeft,
-                                min(mergedRect.bottom, bottom)
-                            );
-                        }
-                        if (!alignedTop && !alignedBottom) {
-                            rects.emplace(
-                                max(mergedRect.left, left),
-                                topNoAlignTop,
-                                min(mergedRect.right, right),
-                                bottomNoAlignTop
-                            );
-                            rects.emplace(
-                                max(mergedRect.left, left),
-                                topNoAlignBottom,
-                                min(mergedRect.right, right),
-                                bottomNoAlignBottom
-                            );
-                        }
-                    }
-                    if (alignedTop || alignedBottom) {
-                        if (alignedTop && !alignedBottom) {
-                            rects.emplace(
-                                max(mergedRect.left, left),
-                                topNoAlignBottom,
-                                min(mergedRect.right, right),
-                                bottomNoAlignBottom
-                            );
-                        }
-                        if (alignedBottom && !alignedTop) {
-                            rects.emplace(
-                                max(mergedRect.left, left),
-                                topNoAlignTop,
-                                min(mergedRect.right, right),
-                                bottomNoAlignTop
-                            );
-                        }
-                        if (!alignedLeft && !alignedRight) {
-                            rects.emplace(
-                                leftNoAlignRight,
-                                max(mergedRect.top, top),
-                                rightNoAlignRight,
-                                min(mergedRect.bottom, bottom)
-                            );
-                            rects.emplace(
-                                leftNoAlignLeft,
-                                max(mergedRect.top, top),
-                                rightNoAlignLeft,
-                                min(mergedRect.bottom, bottom)
-                            );
-                        }
-                    }
-                    if (!alignedLeft && !alignedTop && !alignedRight && !alignedBottom) {
-                        Rect edgeRect(
-                            min(other.left, left),
-                            min(other.top, top),
-                            max(other.left, left),
-                            max(other.bottom, bottom)
-                        );
-                        rects.push(edgeRect);
-                        edgeRect.right  = max(other.right, right);
-                        edgeRect.bottom = max(other.top, top);
-                        rects.push(edgeRect);
-                        edgeRect.left   = min(other.right, right);
-                        edgeRect.top    = min(other.top, top);
-                        edgeRect.bottom = max(other.bottom, bottom);
-                        rects.push(edgeRect);
-                        edgeRect.left = min(other.left, left);
-                        edgeRect.top  = min(other.bottom, bottom);
-                        rects.push(edgeRect);
-                    }
+            if (!(left < other.right && other.left < right &&
+                  top < other.bottom && other.top < bottom)) {
+                if (!empty()) {
+                    rects.push(*this);
                 }
+                return rects;
+            }
+            const Coord midTop    = max(top, other.top);
+            const Coord midBottom = min(bottom, other.bottom);
+            if (top < midTop) {
+                rects.emplace(left, top, right, midTop);
+            }
+            if (left < other.left) {
+                rects.emplace(left, midTop, other.left, midBottom);
+            }
+            if (other.right < right) {
+                rects.emplace(other.right, midTop, right, midBottom);
+            }
+            if (midBottom < bottom) {
+                rects.emplace(left, midBottom, right, bottom);
             }
-            return std::move(rects);
+            return rects;
         }
 
         bool outsideRect(const Rect& other) const noexcept
@@ -493,362 +719,2906 @@ namespace exostra
         }
     };
 
-    inline Color* getGfxBuffer(const GfxContextPtr& ctx)
+    /**
+     * Window text. Short text is copied into inline storage, long text onto the heap
+     * (or truncated, with EWM_STATIC_POOLS), and static text (e.g. string literals,
+     * which live in flash on ESP32) is only referenced.
+     */
+    class WindowText
     {
-# if defined(EWM_GFX_ADAFRUIT)
-        return ctx->getBuffer();
-# else
-        return ctx->getFramebuffer();
+    public:
+        WindowText() = default;
+        explicit WindowText(std::string_view text) { assign(text); }
+        WindowText(const WindowText&) = delete;
+        WindowText& operator=(const WindowText&) = delete;
+
+        const char* c_str() const noexcept { return _ptr; }
+        std::string_view view() const noexcept { return std::string_view(_ptr, _len); }
+        size_t length() const noexcept { return _len; }
+        bool empty() const noexcept { return _len == 0; }
+        bool isStatic() const noexcept { return _static; }
+
+        void assign(std::string_view text)
+        {
+# if defined(EWM_STATIC_POOLS)
+            if (text.size() >= _inline.size()) {
+                EWM_LOG_W("truncating %zu-character text to %zu", text.size(),
+                    _inline.size() - 1);
+                text = text.substr(0, _inline.size() - 1);
+            }
 # endif
-    }
+            if (text.size() < _inline.size()) {
+                std::copy(text.begin(), text.end(), _inline.begin());
+                _inline[text.size()] = '\0';
+                _ptr = _inline.data();
+# if !defined(EWM_STATIC_POOLS)
+                _heap.clear();
+            } else {
+                _heap.assign(text);
+                _ptr = _heap.c_str();
+# endif
+            }
+            _len    = text.size();
+            _static = false;
+        }
 
-    inline GFXglyph* getGlyphAtOffset(const GFXfont* font, uint8_t off)
-    {
-# ifdef __AVR__
-        return &((static_cast<GFXglyph*>(pgm_read_pointer(&font->glyph)))[off]);
-# else
-        return font->glyph + off;
+        /** References text that must remain valid for the lifetime of the window. */
+        void assignStatic(const char* text) noexcept
+        {
+            EWM_ASSERT(text != nullptr);
+# if !defined(EWM_STATIC_POOLS)
+            _heap.clear();
 # endif
-    }
+            _ptr    = text;
+            _len    = std::char_traits<char>::length(text);
+            _static = true;
+        }
 
-    static void getCharBounds(uint8_t ch, uint8_t* cx, uint8_t* cy, uint8_t* xAdv,
-        uint8_t* yAdv, int8_t* xOff, int8_t* yOff, uint8_t textSize = 1,
-        const GFXfont* font = nullptr) noexcept
-    {
-        uint8_t first = font ? pgm_read_byte(&font->first) : 0;
-        bool okCh = font ? ch >= first && ch <= pgm_read_byte(&font->last) : false;
-        auto glyph = okCh ? getGlyphAtOffset(font, ch - first) : nullptr;
-        if (cx) { *cx = textSize * (font ? (okCh ? pgm_read_byte(&glyph->width) : 0) : 6); }
-        if (cy) { *cy = textSize * (font ? (okCh ? pgm_read_byte(&glyph->height) : 0) : 8); }
-        if (xAdv) { *xAdv = textSize * (okCh ? pgm_read_byte(&glyph->xAdvance) : 6); }
-        if (yAdv) { *yAdv = okCh ? pgm_read_byte(&font->yAdvance) : textSize * 8; }
-        if (xOff) { *xOff = okCh ? pgm_read_byte(&glyph->xOffset) : 0; }
-        if (yOff) { *yOff = okCh ? pgm_read_byte(&glyph->yOffset) : 0; }
-    }
+        bool operator==(std::string_view text) const noexcept { return view() == text; }
+        bool operator!=(std::string_view text) const noexcept { return view() != text; }
 
-    template<typename T>
-    constexpr T operator&(const T& t1, const T& t2)
-    {
-        return static_cast<T>(
-            static_cast<unsigned>(t1) & static_cast<unsigned>(t2)
-        );
-    }
+    private:
+        std::array<char, EWM_TEXT_INLINE_SIZE> _inline {};
+# if !defined(EWM_STATIC_POOLS)
+        std::string _heap;
+# endif
+        const char* _ptr = _inline.data();
+        size_t _len      = 0;
+        bool _static     = false;
+    };
 
-    template<typename T>
-    constexpr T operator|(const T& t1, const T& t2)
+    /**
+     * Bounded set of disjoint rects that require flushing. Rects are kept separate
+     * unless merging them is cheaper than flushing them individually, or unless the
+     * capacity has been reached.
+     */
+    class DirtyRegion
     {
-        return static_cast<T>(
-            static_cast<unsigned>(t1) | static_cast<unsigned>(t2)
-        );
-    }
+    public:
+        EWM_CONST(size_t, Capacity, EWM_MAX_DIRTY_RECTS);
+        EWM_CONST(uint32_t, MergeSlackPx, EWM_DIRTY_MERGE_SLACK_PX);
 
-    template<typename T>
-    T constexpr operator~(const T& t1)
-    {
-        return static_cast<T>(
-            ~static_cast<unsigned>(t1)
-        );
-    }
+        DirtyRegion() = default;
 
-    template<typename T1, typename T2>
-    inline bool bitsHigh(const T1& bitmask, const T2& bits) noexcept
-    {
-        return (bitmask & bits) == bits;
-    }
+        bool empty() const noexcept { return _count == 0; }
+        size_t size() const noexcept { return _count; }
 
-    using Mutex     = std::recursive_mutex;
-    using ScopeLock = std::scoped_lock<Mutex>;
+        const Rect* begin() const noexcept { return _rects.data(); }
+        const Rect* end() const noexcept { return _rects.data() + _count; }
 
-    enum class Message : uint8_t
-    {
-        None     = 0,
-        Create   = 1,
-        Destroy  = 2,
-        Draw     = 3,
-        PostDraw = 4,
-        Input    = 5,
-        Event    = 6,
-        Resize   = 7
-    };
+        const Rect& operator[](size_t idx) const noexcept
+        {
+            EWM_ASSERT(idx < _count);
+            return _rects[idx];
+        }
 
-    enum class Style : uint32_t
-    {
-        None       = 0,
-        Visible    =  1 << 0,
-        Child      =  1 << 1,
-        Frame      =  1 << 2,
-        Shadow     =  1 << 3,
-        TopLevel   = (1 << 4) | Frame | Shadow,
-        AutoSize   =  1 << 5,
-        FullScreen =  1 << 6,
-        Button     =  1 << 7,
-        Label      =  1 << 8,
-        Prompt     =  (1 << 9) | TopLevel,
-        Progress   =  1 << 10,
-        CheckBox   =  1 << 11
-    };
+        Rect getBounds() const noexcept
+        {
+            if (empty()) {
+                return Rect();
+            }
+            auto bounds = _rects[0];
+            for (size_t idx = 1; idx < _count; idx++) {
+                bounds.mergeRect(_rects[idx]);
+            }
+            return bounds;
+        }
 
-    enum class State : uint16_t
-    {
-        None    = 0,      /**< Invalid state. */
-        Alive   = 1 << 0, /**< Active (not yet destroyed). */
-        Checked = 1 << 1, /**< Checked/highlighted item. */
-        Dirty   = 1 << 2  /**< Needs redrawing. */
-    };
+        uint32_t getArea() const noexcept
+        {
+            uint32_t area = 0U;
+            for (const auto& rect : *this) {
+                area += _area(rect);
+            }
+            return area;
+        }
 
-    enum class ProgressStyle : uint8_t
-    {
-        Normal        = 1 << 0, /**< Standard linear-fill progress bar. */
-        Indeterminate = 1 << 1  /**< Marquee-style progress bar. */
-    };
+        void clear() noexcept { _count = 0; }
 
-    enum class DrawText : uint8_t
-    {
-        Center   = 1 << 0, /**< Horizontal align center. */
-        Single   = 1 << 1, /**< Single line of text. */
-        Clip     = 1 << 2, /**< Text outside the rect will not be drawn. */
-        Ellipsis = 1 << 3  /**< Replace clipped text with '...' */
-    };
+        /** Adds rect to the region. Returns true if the region grew as a result. */
+        bool add(const Rect& rect) noexcept
+        {
+            if (rect.right <= rect.left || rect.bottom <= rect.top) {
+                return false;
+            }
+            for (size_t idx = 0; idx < _count; idx++) {
+                if (_contains(_rects[idx], rect)) {
+                    return false;
+                }
+            }
+            for (size_t idx = 0; idx < _count;) {
+                if (_contains(rect, _rects[idx])) {
+                    _remove(idx);
+                } else {
+                    idx++;
+                }
+            }
+            for (size_t idx = 0; idx < _count; idx++) {
+                auto merged = rect;
+                merged.mergeRect(_rects[idx]);
+                if (_area(merged) <= _unionArea(rect, _rects[idx]) + MergeSlackPx) {
+                    // Rather than add() the box (which could split it right back into
+                    // the rects it came from), absorb everything that it overlaps.
+                    _remove(idx);
+                    for (size_t other = 0; other < _count;) {
+                        if (_overlaps(merged, _rects[other])) {
+                            merged.mergeRect(_rects[other]);
+                            _remove(other);
+                            other = 0;
+                        } else {
+                            other++;
+                        }
+                    }
+                    _insert(merged);
+                    return true;
+                }
+            }
+            for (size_t idx = 0; idx < _count; idx++) {
+                if (_overlaps(rect, _rects[idx])) {
+                    const auto other = _rects[idx];
+                    const Coord midTop    = max(rect.top, other.top);
+                    const Coord midBottom = min(rect.bottom, other.bottom);
+                    add(Rect(rect.left, rect.top, rect.right, midTop));
+                    add(Rect(rect.left, midBottom, rect.right, rect.bottom));
+                    add(Rect(rect.left, midTop, other.left, midBottom));
+                    add(Rect(other.right, midTop, rect.right, midBottom));
+                    return true;
+                }
+            }
+            _insert(rect);
+            return true;
+        }
 
-    enum class EventType : uint8_t
-    {
-        ChildTapped = 1
-    };
+    private:
+        void _insert(Rect rect) noexcept
+        {
+            if (_count == Capacity) {
+                // Full: fold the new rect into whichever existing rect it combines
+                // with most cheaply, then absorb anything the result overlaps.
+                size_t cheapest = 0;
+                uint32_t minWaste = UINT32_MAX;
+                for (size_t idx = 0; idx < _count; idx++) {
+                    auto merged = rect;
+                    merged.mergeRect(_rects[idx]);
+                    const auto waste = _area(merged) - _unionArea(rect, _rects[idx]);
+                    if (waste < minWaste) {
+                        minWaste = waste;
+                        cheapest = idx;
+                    }
+                }
+                rect.mergeRect(_rects[cheapest]);
+                _remove(cheapest);
+                for (size_t idx = 0; idx < _count;) {
+                    if (_overlaps(rect, _rects[idx])) {
+                        rect.mergeRect(_rects[idx]);
+                        _remove(idx);
+                        idx = 0;
+                    } else {
+                        idx++;
+                    }
+                }
+            }
+            _rects[_count++] = rect;
+        }
 
-    enum class InputType : uint8_t
-    {
-        None = 0,
-        Tap  = 1
-    };
+        void _remove(size_t idx) noexcept
+        {
+            EWM_ASSERT(idx < _count);
+            _rects[idx] = _rects[--_count];
+        }
 
-    struct InputParams
-    {
-# if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
-        std::string handledBy;
-# endif
-        InputType type = InputType::None;
-        Coord x = 0;
-        Coord y = 0;
-    };
-
-    static MsgParam makeMsgParam(const MsgParamWord& hiWord, const MsgParamWord& loWord)
-    {
-        return (static_cast<MsgParam>(hiWord) << 16) | (loWord & 0xffffU);
-    }
-
-    static MsgParamWord getMsgParamHiWord(const MsgParam& msgParam)
-    {
-        return ((msgParam >> 16) & 0xffffU);
-    }
-
-    static MsgParamWord getMsgParamLoWord(const MsgParam& msgParam)
-    {
-        return (msgParam & 0xffffU);
-    }
-
-    enum class ColorID : uint8_t
-    {
-        Screensaver = 1,
-
-        PromptBg,
-        PromptFrame,
-        PromptShadow,
+        static uint32_t _area(const Rect& rect) noexcept
+        {
+            if (rect.right <= rect.left || rect.bottom <= rect.top) {
+                return 0U;
+            }
+            return static_cast<uint32_t>(rect.right - rect.left) * (rect.bottom - rect.top);
+        }
 
-        WindowText,
-        WindowBg,
-        WindowFrame,
-        WindowShadow,
+        static uint32_t _unionArea(const Rect& a, const Rect& b) noexcept
+        {
+            const Rect overlap(
+                max(a.left, b.left),
+                max(a.top, b.top),
+                min(a.right, b.right),
+                min(a.bottom, b.bottom)
+            );
+            return _area(a) + _area(b) - _area(overlap);
+        }
 
-        ButtonText,
-        ButtonTextPressed,
-        ButtonBg,
-        ButtonBgPressed,
-        ButtonFrame,
-        ButtonFramePressed,
+        static bool _overlaps(const Rect& a, const Rect& b) noexcept
+        {
+            return a.left < b.right && b.left < a.right &&
+                   a.top < b.bottom && b.top < a.bottom;
+        }
 
-        ProgressBg,
-        ProgressFill,
+        static bool _contains(const Rect& outer, const Rect& inner) noexcept
+        {
+            return inner.left >= outer.left && inner.right <= outer.right &&
+                   inner.top >= outer.top && inner.bottom <= outer.bottom;
+        }
 
-        CheckBoxCheckBg,
-        CheckBoxCheckFrame,
-        CheckBoxCheck
+        std::array<Rect, Capacity> _rects {};
+        size_t _count = 0;
     };
 
-    enum class MetricID : uint8_t
+    /**
+     * Area made up of disjoint rects, stored YX-banded: sorted by top edge, then by
+     * left edge, with every rect in a band sharing the same top and bottom edges, and
+     * vertically adjacent bands with identical spans coalesced. Set operations are
+     * exact and never allocate, unless the result would need more than Capacity rects:
+     * it is then replaced by its bounding box (which is a superset of it).
+     */
+    class Region
     {
-        XPadding = 1,             /**< Extent */
-        YPadding,                 /**< Extent */
-
-        DefTextSize,              /**< uint8_t */
-
-        WindowFramePx,            /**< Extent */
-        CornerRadiusWindow,       /**< Coord */
-        CornerRadiusButton,       /**< Coord */
-        CornerRadiusPrompt,       /**< Coord */
-        CornerRadiusCheckBox,     /**< Coord */
+    public:
+        EWM_CONST(size_t, Capacity, EWM_MAX_REGION_RECTS);
 
-        DefButtonCX,              /**< Extent */
-        DefButtonCY,              /**< Extent */
-        ButtonLabelPadding,       /**< Extent */
-        ButtonTappedDuration,     /**< uint32_t */
+        Region() = default;
 
-        MaxPromptCX,              /**< Extent */
-        MaxPromptCY,              /**< Extent */
+        explicit Region(const Rect& rect) noexcept
+        {
+            if (rect.right > rect.left && rect.bottom > rect.top) {
+                _rects[_count++] = rect;
+            }
+        }
 
-        DefProgressHeight,        /**< Extent */
-        ProgressMarqueeCXFactor,  /**< float */
-        ProgressMarqueeStep,      /**< float */
+        bool empty() const noexcept { return _count == 0; }
+        size_t size() const noexcept { return _count; }
 
-        DefCheckBoxHeight,        /**< Extent */
-        CheckBoxCheckAreaPadding, /**< Extent */
-        CheckBoxCheckMarkPadding, /**< Extent */
-        CheckBoxCheckDelay        /**< uint32_t */
-    };
+        const Rect* begin() const noexcept { return _rects.data(); }
+        const Rect* end() const noexcept { return _rects.data() + _count; }
 
-    struct Variant
-    {
-        enum class Type : uint8_t
+        const Rect& operator[](size_t idx) const noexcept
         {
-            Empty  = 0,
-            Extent = 1,
-            Coord  = 2,
-            UInt8  = 3,
-            UInt32 = 4,
-            Float  = 5
-        };
+            EWM_ASSERT(idx < _count);
+            return _rects[idx];
+        }
 
-        Variant() = default;
+        void clear() noexcept { _count = 0; }
 
-        Type getType() const noexcept { return _type; }
+        Rect getBounds() const noexcept
+        {
+            if (empty()) {
+                return Rect();
+            }
+            auto bounds = _rects[0];
+            for (size_t idx = 1; idx < _count; idx++) {
+                bounds.mergeRect(_rects[idx]);
+            }
+            return bounds;
+        }
 
-        Extent getExtent() const noexcept
+        bool intersects(const Rect& rect) const noexcept
         {
-            EWM_ASSERT(_type == Type::Extent);
-            return _extentValue;
+            for (const auto& r : *this) {
+                if (r.left < rect.right && rect.left < r.right &&
+                    r.top < rect.bottom && rect.top < r.bottom) {
+                    return true;
+                }
+            }
+            return false;
         }
 
-        void setExtent(const Extent& extent) noexcept
+        bool contains(const Rect& rect) const noexcept
         {
-            _extentValue = extent;
-            _type = Type::Extent;
+            return Region(rect).subtract(*this).empty();
         }
 
-        Coord getCoord() const noexcept
+        bool operator==(const Region& rhs) const noexcept
         {
-            EWM_ASSERT(_type == Type::Coord);
-            return _coordValue;
+            return _count == rhs._count && std::equal(begin(), end(), rhs.begin());
         }
 
-        void setCoord(const Coord& coord) noexcept
+        bool operator!=(const Region& rhs) const noexcept { return !(*this == rhs); }
+
+        Region& unite(const Rect& rect) noexcept { return unite(Region(rect)); }
+        Region& unite(const Region& other) noexcept { return _combine(other, Op::Union); }
+
+        Region& intersect(const Rect& rect) noexcept
         {
-            _coordValue = coord;
-            _type = Type::Coord;
+            // Clipping preserves the banding, so no need for the general case.
+            size_t count = 0;
+            for (size_t idx = 0; idx < _count; idx++) {
+                const Rect clipped(
+                    max(_rects[idx].left, rect.left),
+                    max(_rects[idx].top, rect.top),
+                    min(_rects[idx].right, rect.right),
+                    min(_rects[idx].bottom, rect.bottom)
+                );
+                if (clipped.right > clipped.left && clipped.bottom > clipped.top) {
+                    _rects[count++] = clipped;
+                }
+            }
+            _count = count;
+            return *this;
         }
 
-        uint8_t getUint8() const noexcept
+        Region& intersect(const Region& other) noexcept
         {
-            EWM_ASSERT(_type == Type::UInt8);
-            return _uint8Value;
+            return _combine(other, Op::Intersect);
         }
 
-        void setUint8(const uint8_t& octet) noexcept
+        Region& subtract(const Rect& rect) noexcept { return subtract(Region(rect)); }
+        Region& subtract(const Region& other) noexcept
         {
-            _uint8Value = octet;
-            _type = Type::UInt8;
+            return _combine(other, Op::Subtract);
         }
 
-        uint32_t getUint32() const noexcept
+    private:
+        enum class Op : uint8_t
         {
-            EWM_ASSERT(_type == Type::UInt32);
-            return _uint32Value;
+            Union,
+            Intersect,
+            Subtract
+        };
+
+        struct Span
+        {
+            Coord left  = 0;
+            Coord right = 0;
+        };
+
+        using EdgeList = std::array<Coord, Capacity * 4>;
+        using SpanList = std::array<Span, Capacity * 2>;
+
+        Region& _combine(const Region& other, Op op) noexcept
+        {
+            if (op == Op::Intersect && (empty() || other.empty())) {
+                clear();
+                return *this;
+            }
+            if (other.empty()) {
+                return *this;
+            }
+            if (empty()) {
+                if (op == Op::Union) {
+                    *this = other;
+                }
+                return *this;
+            }
+            EdgeList ys;
+            size_t numYs = 0;
+            const Region* regions[] = { this, &other };
+            for (const auto* region : regions) {
+                for (const auto& rect : *region) {
+                    ys[numYs++] = rect.top;
+                    ys[numYs++] = rect.bottom;
+                }
+            }
+            std::sort(ys.begin(), ys.begin() + numYs);
+            numYs = std::unique(ys.begin(), ys.begin() + numYs) - ys.begin();
+
+            Region result;
+            size_t prevBand = 0;
+            size_t prevSize = 0;
+            bool overflow   = false;
+            int left        = INT_MAX;
+            int right       = INT_MIN;
+            int top         = INT_MAX;
+            int bottom      = INT_MIN;
+            for (size_t band = 0; band + 1 < numYs; band++) {
+                const Coord y0 = ys[band];
+                const Coord y1 = ys[band + 1];
+                SpanList a, b, spans;
+                const size_t numA = _getSpans(*this, y0, y1, a);
+                const size_t numB = _getSpans(other, y0, y1, b);
+                const size_t numSpans = _combineSpans(a, numA, b, numB, op, spans);
+                if (numSpans == 0) {
+                    prevSize = 0;
+                    continue;
+                }
+                left   = min(left, static_cast<int>(spans[0].left));
+                right  = max(right, static_cast<int>(spans[numSpans - 1].right));
+                top    = min(top, static_cast<int>(y0));
+                bottom = max(bottom, static_cast<int>(y1));
+                if (overflow) {
+                    continue;
+                }
+                bool coalesce = prevSize == numSpans &&
+                    result._rects[prevBand].bottom == y0;
+                for (size_t idx = 0; coalesce && idx < numSpans; idx++) {
+                    const auto& prev = result._rects[prevBand + idx];
+                    coalesce = prev.left == spans[idx].left && prev.right == spans[idx].right;
+                }
+                if (coalesce) {
+                    for (size_t idx = 0; idx < numSpans; idx++) {
+                        result._rects[prevBand + idx].bottom = y1;
+                    }
+                    continue;
+                }
+                if (result._count + numSpans > Capacity) {
+                    // Only the bounds are still needed.
+                    overflow = true;
+                    continue;
+                }
+                prevBand = result._count;
+                prevSize = numSpans;
+                for (size_t idx = 0; idx < numSpans; idx++) {
+                    result._rects[result._count++] =
+                        Rect(spans[idx].left, y0, spans[idx].right, y1);
+                }
+            }
+            if (overflow) {
+                EWM_LOG_W("region capacity (%zu) exceeded; using the bounding box", Capacity);
+                *this = Region(Rect(static_cast<Coord>(left), static_cast<Coord>(top),
+                    static_cast<Extent>(right), static_cast<Extent>(bottom)));
+                return *this;
+            }
+            *this = result;
+            return *this;
         }
 
-        void setUint32(const uint32_t& dword) noexcept
+        static size_t _getSpans(const Region& region, Coord y0, Coord y1, SpanList& spans) noexcept
         {
-            _uint32Value = dword;
-            _type = Type::UInt32;
+            size_t count = 0;
+            for (const auto& rect : region) {
+                if (rect.top <= y0 && rect.bottom >= y1) {
+                    spans[count].left  = rect.left;
+                    spans[count].right = rect.right;
+                    count++;
+                }
+            }
+            std::sort(spans.begin(), spans.begin() + count,
+                [](const Span& lhs, const Span& rhs) { return lhs.left < rhs.left; });
+            return count;
         }
 
-        float getFloat() const noexcept
+        static bool _spansCover(const SpanList& spans, size_t count, Coord x0, Coord x1) noexcept
         {
-            EWM_ASSERT(_type == Type::Float);
-            return _floatValue;
+            for (size_t idx = 0; idx < count; idx++) {
+                if (spans[idx].left <= x0 && spans[idx].right >= x1) {
+                    return true;
+                }
+            }
+            return false;
         }
 
-        void setFloat(const float& flt) noexcept
+        static size_t _combineSpans(const SpanList& a, size_t numA, const SpanList& b,
+            size_t numB, Op op, SpanList& out) noexcept
         {
-            _floatValue = flt;
-            _type = Type::Float;
+            EdgeList xs;
+            size_t numXs = 0;
+            for (size_t idx = 0; idx < numA; idx++) {
+                xs[numXs++] = a[idx].left;
+                xs[numXs++] = a[idx].right;
+            }
+            for (size_t idx = 0; idx < numB; idx++) {
+                xs[numXs++] = b[idx].left;
+                xs[numXs++] = b[idx].right;
+            }
+            std::sort(xs.begin(), xs.begin() + numXs);
+            numXs = std::unique(xs.begin(), xs.begin() + numXs) - xs.begin();
+            size_t count = 0;
+            for (size_t idx = 0; idx + 1 < numXs; idx++) {
+                const bool inA = _spansCover(a, numA, xs[idx], xs[idx + 1]);
+                const bool inB = _spansCover(b, numB, xs[idx], xs[idx + 1]);
+                bool inResult = false;
+                switch (op) {
+                    case Op::Union:     inResult = inA || inB; break;
+                    case Op::Intersect: inResult = inA && inB; break;
+                    case Op::Subtract:  inResult = inA && !inB; break;
+                }
+                if (!inResult) {
+                    continue;
+                }
+                if (count > 0 && out[count - 1].right == xs[idx]) {
+                    out[count - 1].right = xs[idx + 1];
+                } else {
+                    out[count].left  = xs[idx];
+                    out[count].right = xs[idx + 1];
+                    count++;
+                }
+            }
+            return count;
         }
 
-    private:
-        union
+        std::array<Rect, Capacity> _rects {};
+        size_t _count = 0;
+    };
+
+    /**
+     * Cost model of transfers to the display: every transaction has a fixed overhead
+     * (e.g. setting an SPI address window), and the payload costs time in proportion
+     * to its size.
+     */
+    struct FlushCost
+    {
+        float overheadUs = EWM_FLUSH_OVERHEAD_US;
+        float bytesPerUs = EWM_FLUSH_BYTES_PER_US;
+
+        /** Returns the estimated time (in microseconds) that transferring rect takes. */
+        float getCost(const Rect& rect) const noexcept
         {
-            Extent _extentValue;
-            Coord _coordValue;
-            uint8_t _uint8Value;
-            uint32_t _uint32Value;
-            float _floatValue = 0.0f;
-        };
-        Type _type = Type::Empty;
+            const float bytes = static_cast<float>(rect.width()) * rect.height() * sizeof(Color);
+            return overheadUs + (bytes / bytesPerUs);
+        }
     };
 
-    class ITheme
+    /**
+     * Rects that a region is transferred to the display in. Starting from the disjoint
+     * rects of the region (so an L-shape is split rather than sent as its bounding
+     * box), the pair of rects whose bounding box is cheapest to send in one transaction
+     * is merged, repeatedly, for as long as that saves time. Bounding boxes may only
+     * take in pixels that are within `allowed` (i.e. current in the source buffer, and
+     * not covered by anything else), and must contain any other rects they touch.
+     * Finally, rects are widened to EWM_FLUSH_ALIGN boundaries where allowed.
+     */
+    class FlushPlan
     {
     public:
-        enum class DisplaySize : uint8_t
-        {
-            Small = 0,
-            Medium,
-            Large
-        };
+        EWM_CONST(size_t, Capacity, EWM_MAX_REGION_RECTS);
+        EWM_CONST(Coord, Align, EWM_FLUSH_ALIGN);
 
-        virtual void setDisplayExtents(Extent, Extent) = 0;
+        FlushPlan(const Region& region, const Region& allowed, const FlushCost& cost) noexcept
+        {
+            for (const auto& rect : region) {
+                _rects[_count++] = rect;
+            }
+            while (_mergeCheapest(allowed, cost)) { }
+            _align(allowed);
+        }
 
-        virtual Color getColor(ColorID) const = 0;
-        virtual Variant getMetric(MetricID) const = 0;
+        bool empty() const noexcept { return _count == 0; }
+        size_t size() const noexcept { return _count; }
 
-        virtual void drawScreensaver(const GfxDisplayPtr&) const = 0;
+        const Rect* begin() const noexcept { return _rects.data(); }
+        const Rect* end() const noexcept { return _rects.data() + _count; }
 
-        virtual void setDefaultFont(const Font*) = 0;
-        virtual const Font* getDefaultFont() const = 0;
+    private:
+        bool _mergeCheapest(const Region& allowed, const FlushCost& cost) noexcept
+        {
+            float bestSavings = 0.0f;
+            Rect best;
+            for (size_t first = 0; first < _count; first++) {
+                for (size_t second = first + 1; second < _count; second++) {
+                    auto merged = _rects[first];
+                    merged.mergeRect(_rects[second]);
+                    float savings = -cost.getCost(merged);
+                    bool valid    = true;
+                    for (size_t idx = 0; valid && idx < _count; idx++) {
+                        if (_contains(merged, _rects[idx])) {
+                            savings += cost.getCost(_rects[idx]);
+                        } else if (_overlaps(merged, _rects[idx])) {
+                            valid = false;
+                        }
+                    }
+                    if (valid && savings > bestSavings && allowed.contains(merged)) {
+                        bestSavings = savings;
+                        best        = merged;
+                    }
+                }
+            }
+            if (bestSavings <= 0.0f) {
+                return false;
+            }
+            size_t count = 0;
+            for (size_t idx = 0; idx < _count; idx++) {
+                if (!_contains(best, _rects[idx])) {
+                    _rects[count++] = _rects[idx];
+                }
+            }
+            _rects[count++] = best;
+            _count = count;
+            return true;
+        }
 
-        virtual DisplaySize getDisplaySize() const = 0;
-        virtual Extent getScaledValue(Extent) const = 0;
+        void _align(const Region& allowed) noexcept
+        {
+            if (Align <= 1) {
+                return;
+            }
+            for (size_t idx = 0; idx < _count; idx++) {
+                auto aligned  = _rects[idx];
+                aligned.left  = aligned.left - (aligned.left % Align);
+                aligned.right = aligned.right + ((Align - (aligned.right % Align)) % Align);
+                if (aligned == _rects[idx] || !allowed.contains(aligned)) {
+                    continue;
+                }
+                bool overlaps = false;
+                for (size_t other = 0; !overlaps && other < _count; other++) {
+                    overlaps = other != idx && _overlaps(aligned, _rects[other]);
+                }
+                if (!overlaps) {
+                    _rects[idx] = aligned;
+                }
+            }
+        }
 
-        virtual void drawWindowFrame(const GfxContextPtr&, const Rect&, Coord, Color) const = 0;
-        virtual void drawWindowShadow(const GfxContextPtr&, const Rect&, Coord, Color) const = 0;
-        virtual void drawWindowBackground(const GfxContextPtr&, const Rect&, Coord, Color) const = 0;
-        virtual void drawText(const GfxContextPtr&, const char*, DrawText, const Rect&,
-            uint8_t, Color, const Font*) const = 0;
+        static bool _overlaps(const Rect& a, const Rect& b) noexcept
+        {
+            return a.left < b.right && b.left < a.right &&
+                   a.top < b.bottom && b.top < a.bottom;
+        }
 
-        virtual void drawProgressBarBackground(const GfxContextPtr&, const Rect&) const = 0;
-        virtual void drawProgressBarProgress(const GfxContextPtr&, const Rect&, float) const = 0;
-        virtual void drawProgressBarIndeterminate(const GfxContextPtr&, const Rect&, float) const = 0;
+        static bool _contains(const Rect& outer, const Rect& inner) noexcept
+        {
+            return inner.left >= outer.left && inner.right <= outer.right &&
+                   inner.top >= outer.top && inner.bottom <= outer.bottom;
+        }
 
-        virtual void drawCheckBox(const GfxContextPtr&, const char*, bool, const Rect&) const = 0;
+        std::array<Rect, Capacity> _rects {};
+        size_t _count = 0;
     };
 
-    using ThemePtr = std::shared_ptr<ITheme>;
-
-    class DefaultTheme : public ITheme
+    /**
+     * Kernels that fill, copy, byte-swap and blend runs of 565 pixels, with a scalar
+     * implementation of each, and a vectorized one where the target has SSE2 or NEON
+     * (or, with EWM_SIMD_PIE, vectorized fill and byte-swap on the ESP32-S3).
+     * The first time the kernels are needed, the vectorized ones are checked against
+     * the scalar ones, and they are only used if they produce the same pixels.
+     */
+    class PixelKernels
     {
     public:
-        DefaultTheme() = default;
+        using FillFn  = void (*)(Color* dst, size_t count, Color color);
+        using CopyFn  = void (*)(Color* dst, const Color* src, size_t count);
+        using BlendFn = void (*)(Color* dst, const Color* src, size_t count, uint8_t alpha);
 
-        void setDisplayExtents(Extent width, Extent height) final
+        const char* name   = "scalar";
+        FillFn fill        = _fillScalar;
+        CopyFn copy        = _copyScalar;
+        CopyFn copySwapped = _copySwappedScalar; /**< Swaps the bytes of each pixel. */
+        BlendFn blend      = _blendScalar; /**< Blends src over dst (alpha 255 is src). */
+
+        /** Returns the kernels in use. */
+        static const PixelKernels& get() noexcept
         {
-            _displayWidth  = width;
-            _displayHeight = height;
+            static const PixelKernels kernels = _select();
+            return kernels;
         }
 
-        Color getColor(ColorID colorID) const final
-        {
-            switch (colorID) {
-                case ColorID::Screensaver:        return 0x0000;
-                case ColorID::PromptBg:           return 0xef5c;
-                case ColorID::PromptFrame:        return 0x9cf3;
-                case ColorID::PromptShadow:       return 0xb5b6;
+        /**
+         * Returns the vectorized kernels (the scalar ones, if there are none). Plain
+         * copies are left to memcpy(), which the C library already vectorizes.
+         */
+        static PixelKernels getVectorized() noexcept
+        {
+            PixelKernels kernels;
+# if defined(EWM_SIMD_SSE2)
+            kernels.name        = "SSE2";
+            kernels.fill        = _fillSSE2;
+            kernels.copySwapped = _copySwappedSSE2;
+            kernels.blend       = _blendSSE2;
+# elif defined(EWM_SIMD_NEON)
+            kernels.name        = "NEON";
+            kernels.fill        = _fillNEON;
+            kernels.copySwapped = _copySwappedNEON;
+            kernels.blend       = _blendNEON;
+# elif defined(EWM_SIMD_PIE)
+            kernels.name        = "PIE";
+            kernels.fill        = _fillPIE;
+            kernels.copySwapped = _copySwappedPIE;
+# endif
+            return kernels;
+        }
+
+        /**
+         * Returns true if kernels produce the same pixels as the scalar kernels, for runs
+         * of every length up to a few vectors, at every alignment.
+         */
+        static bool selfCheck(const PixelKernels& kernels) noexcept
+        {
+            EWM_CONST(size_t, MaxCount, 67);
+            EWM_CONST(size_t, MaxOffset, 8);
+            const PixelKernels scalar;
+            std::array<Color, MaxCount + MaxOffset> src {};
+            std::array<Color, MaxCount + MaxOffset> dst {};
+            std::array<Color, MaxCount + MaxOffset> expected {};
+            std::array<Color, MaxCount + MaxOffset> actual {};
+            uint32_t state = 0x9e3779b9U;
+            auto next = [&state]()
+            {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                return static_cast<Color>(state);
+            };
+            for (size_t idx = 0; idx < src.size(); idx++) {
+                src[idx] = next();
+                dst[idx] = next();
+            }
+            for (size_t offset = 0; offset < MaxOffset; offset++) {
+                for (size_t count = 0; count <= MaxCount; count++) {
+                    auto check = [&](auto&& run)
+                    {
+                        expected = dst;
+                        actual   = dst;
+                        run(scalar, expected.data() + offset, src.data() + (MaxOffset - offset));
+                        run(kernels, actual.data() + offset, src.data() + (MaxOffset - offset));
+                        return expected == actual;
+                    };
+                    const Color color = next();
+                    bool ok = check([&](const PixelKernels& k, Color* out, const Color*)
+                    {
+                        k.fill(out, count, color);
+                    });
+                    ok = ok && check([&](const PixelKernels& k, Color* out, const Color* in)
+                    {
+                        k.copy(out, in, count);
+                    });
+                    ok = ok && check([&](const PixelKernels& k, Color* out, const Color* in)
+                    {
+                        k.copySwapped(out, in, count);
+                    });
+                    for (const uint8_t alpha : { 0, 1, 77, 128, 200, 255 }) {
+                        ok = ok && check([&](const PixelKernels& k, Color* out, const Color* in)
+                        {
+                            k.blend(out, in, count, alpha);
+                        });
+                    }
+                    if (!ok) {
+                        EWM_LOG_E("%s kernels differ from scalar (count: %zu, offset: %zu)",
+                            kernels.name, count, offset);
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        /** Fills a rect of pixels whose rows are stride pixels apart. */
+        static void fillRect(Color* dst, size_t stride, Extent w, Extent h, Color color) noexcept
+        {
+            const auto fill = get().fill;
+            for (Extent row = 0; row < h; row++, dst += stride) {
+                fill(dst, w, color);
+            }
+        }
+
+        /** Copies a rect of pixels between buffers with the given strides. */
+        static void copyRect(Color* dst, size_t dstStride, const Color* src, size_t srcStride,
+            Extent w, Extent h) noexcept
+        {
+            const auto copy = get().copy;
+            for (Extent row = 0; row < h; row++, dst += dstStride, src += srcStride) {
+                copy(dst, src, w);
+            }
+        }
+
+    private:
+        static PixelKernels _select() noexcept
+        {
+            const auto kernels = getVectorized();
+            if (kernels.fill == _fillScalar) {
+                return kernels;
+            }
+            if (!selfCheck(kernels)) {
+                EWM_LOG_E("%s pixel kernels failed the self-check; using scalar kernels",
+                    kernels.name);
+                return PixelKernels();
+            }
+            EWM_LOG_D("using %s pixel kernels", kernels.name);
+            return kernels;
+        }
+
+        /** Weight (out of 32) of the source in a blend, i.e. 5 bits, as in 565. */
+        static uint16_t _getBlendWeight(uint8_t alpha) noexcept
+        {
+            return static_cast<uint16_t>((alpha + 4) >> 3);
+        }
+
+        static void _fillScalar(Color* dst, size_t count, Color color) noexcept
+        {
+            if (count == 0) {
+                return;
+            }
+            // Two pixels per (aligned) 32-bit store.
+            if ((reinterpret_cast<uintptr_t>(dst) & (sizeof(uint32_t) - 1)) != 0) {
+                *dst++ = color;
+                count--;
+            }
+            const uint32_t pair = (static_cast<uint32_t>(color) << 16) | color;
+            for (size_t idx = 0; idx < count / 2; idx++) {
+                std::memcpy(dst + (idx * 2), &pair, sizeof(pair));
+            }
+            if ((count & 1) != 0) {
+                dst[count - 1] = color;
+            }
+        }
+
+        static void _copyScalar(Color* dst, const Color* src, size_t count) noexcept
+        {
+            std::memcpy(dst, src, count * sizeof(Color));
+        }
+
+        static void _copySwappedScalar(Color* dst, const Color* src, size_t count) noexcept
+        {
+            for (size_t idx = 0; idx < count; idx++) {
+                dst[idx] = static_cast<Color>((src[idx] << 8) | (src[idx] >> 8));
+            }
+        }
+
+        static void _blendScalar(Color* dst, const Color* src, size_t count,
+            uint8_t alpha) noexcept
+        {
+            // Spreads the channels out (-G-R-B) so that all three blend in one multiply.
+            EWM_CONST(uint32_t, Mask, 0x07e0f81fU);
+            const uint32_t weight = _getBlendWeight(alpha);
+            for (size_t idx = 0; idx < count; idx++) {
+                const uint32_t s = (src[idx] | (static_cast<uint32_t>(src[idx]) << 16)) & Mask;
+                const uint32_t d = (dst[idx] | (static_cast<uint32_t>(dst[idx]) << 16)) & Mask;
+                const uint32_t out = (((s * weight) + (d * (32U - weight))) >> 5) & Mask;
+                dst[idx] = static_cast<Color>(out | (out >> 16));
+            }
+        }
+
+# if defined(EWM_SIMD_SSE2)
+        static void _fillSSE2(Color* dst, size_t count, Color color) noexcept
+        {
+            const __m128i value = _mm_set1_epi16(static_cast<short>(color));
+            size_t idx = 0;
+            for (; idx + 8 <= count; idx += 8) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + idx), value);
+            }
+            _fillScalar(dst + idx, count - idx, color);
+        }
+
+        static void _copySwappedSSE2(Color* dst, const Color* src, size_t count) noexcept
+        {
+            size_t idx = 0;
+            for (; idx + 8 <= count; idx += 8) {
+                const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + idx));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + idx),
+                    _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8)));
+            }
+            _copySwappedScalar(dst + idx, src + idx, count - idx);
+        }
+
+        static void _blendSSE2(Color* dst, const Color* src, size_t count,
+            uint8_t alpha) noexcept
+        {
+            const auto weight     = static_cast<short>(_getBlendWeight(alpha));
+            const __m128i sWeight = _mm_set1_epi16(weight);
+            const __m128i dWeight = _mm_set1_epi16(static_cast<short>(32 - weight));
+            const __m128i green   = _mm_set1_epi16(0x3f);
+            const __m128i blue    = _mm_set1_epi16(0x1f);
+            auto mix = [&](__m128i s, __m128i d)
+            {
+                return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(s, sWeight),
+                    _mm_mullo_epi16(d, dWeight)), 5);
+            };
+            size_t idx = 0;
+            for (; idx + 8 <= count; idx += 8) {
+                const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + idx));
+                const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + idx));
+                const __m128i r = mix(_mm_srli_epi16(s, 11), _mm_srli_epi16(d, 11));
+                const __m128i g = mix(_mm_and_si128(_mm_srli_epi16(s, 5), green),
+                    _mm_and_si128(_mm_srli_epi16(d, 5), green));
+                const __m128i b = mix(_mm_and_si128(s, blue), _mm_and_si128(d, blue));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + idx), _mm_or_si128(
+                    _mm_or_si128(_mm_slli_epi16(r, 11), _mm_slli_epi16(g, 5)), b));
+            }
+            _blendScalar(dst + idx, src + idx, count - idx, alpha);
+        }
+# elif defined(EWM_SIMD_NEON)
+        static void _fillNEON(Color* dst, size_t count, Color color) noexcept
+        {
+            const uint16x8_t value = vdupq_n_u16(color);
+            size_t idx = 0;
+            for (; idx + 8 <= count; idx += 8) {
+                vst1q_u16(dst + idx, value);
+            }
+            _fillScalar(dst + idx, count - idx, color);
+        }
+
+        static void _copySwappedNEON(Color* dst, const Color* src, size_t count) noexcept
+        {
+            size_t idx = 0;
+            for (; idx + 8 <= count; idx += 8) {
+                const uint8x16_t bytes = vreinterpretq_u8_u16(vld1q_u16(src + idx));
+                vst1q_u16(dst + idx, vreinterpretq_u16_u8(vrev16q_u8(bytes)));
+            }
+            _copySwappedScalar(dst + idx, src + idx, count - idx);
+        }
+
+        static void _blendNEON(Color* dst, const Color* src, size_t count,
+            uint8_t alpha) noexcept
+        {
+            const uint16_t weight     = _getBlendWeight(alpha);
+            const uint16x8_t sWeight  = vdupq_n_u16(weight);
+            const uint16x8_t dWeight  = vdupq_n_u16(static_cast<uint16_t>(32 - weight));
+            const uint16x8_t green    = vdupq_n_u16(0x3f);
+            const uint16x8_t blue     = vdupq_n_u16(0x1f);
+            auto mix = [&](uint16x8_t s, uint16x8_t d)
+            {
+                return vshrq_n_u16(vmlaq_u16(vmulq_u16(s, sWeight), d, dWeight), 5);
+            };
+            size_t idx = 0;
+            for (; idx + 8 <= count; idx += 8) {
+                const uint16x8_t s = vld1q_u16(src + idx);
+                const uint16x8_t d = vld1q_u16(dst + idx);
+                const uint16x8_t r = mix(vshrq_n_u16(s, 11), vshrq_n_u16(d, 11));
+                const uint16x8_t g = mix(vandq_u16(vshrq_n_u16(s, 5), green),
+                    vandq_u16(vshrq_n_u16(d, 5), green));
+                const uint16x8_t b = mix(vandq_u16(s, blue), vandq_u16(d, blue));
+                vst1q_u16(dst + idx,
+                    vorrq_u16(vorrq_u16(vshlq_n_u16(r, 11), vshlq_n_u16(g, 5)), b));
+            }
+            _blendScalar(dst + idx, src + idx, count - idx, alpha);
+        }
+# elif defined(EWM_SIMD_PIE)
+        /** Number of pixels in a 128-bit Q register. */
+        EWM_CONST(size_t, PIEPixels, 16 / sizeof(Color));
+
+        static bool _isAlignedPIE(const Color* ptr) noexcept
+        {
+            return (reinterpret_cast<uintptr_t>(ptr) & 15U) == 0;
+        }
+
+        static void _fillPIE(Color* dst, size_t count, Color color) noexcept
+        {
+            // EE.VST.128.IP ignores the low four bits of the address.
+            while (count > 0 && !_isAlignedPIE(dst)) {
+                *dst++ = color;
+                count--;
+            }
+            const size_t vectors = count / PIEPixels;
+            if (vectors > 0) {
+                Color* out = dst;
+                asm volatile(
+                    "ee.vldbc.16 q0, %[color]\n"
+                    "loopnez %[vectors], 1f\n"
+                    "ee.vst.128.ip q0, %[out], 16\n"
+                    "1:\n"
+                    : [out] "+r" (out)
+                    : [color] "r" (&color), [vectors] "r" (vectors)
+                    : "memory"
+                );
+            }
+            _fillScalar(dst + (vectors * PIEPixels), count - (vectors * PIEPixels), color);
+        }
+
+        static void _copySwappedPIE(Color* dst, const Color* src, size_t count) noexcept
+        {
+            alignas(16) static const uint32_t masks[8] = {
+                0x00ff00ffU, 0x00ff00ffU, 0x00ff00ffU, 0x00ff00ffU,
+                0xff00ff00U, 0xff00ff00U, 0xff00ff00U, 0xff00ff00U
+            };
+            while (count > 0 && !_isAlignedPIE(dst)) {
+                _copySwappedScalar(dst++, src++, 1);
+                count--;
+            }
+            // Loads must be aligned too; callers that can, align src and dst alike.
+            const size_t vectors = _isAlignedPIE(src) ? count / PIEPixels : 0;
+            if (vectors > 0) {
+                const uint32_t* mask = masks;
+                const Color* in      = src;
+                Color* out           = dst;
+                // Each 32-bit lane: ((x >> 8) & 0x00ff00ff) | ((x << 8) & 0xff00ff00).
+                asm volatile(
+                    "ssai 8\n"
+                    "ee.vld.128.ip q6, %[mask], 16\n"
+                    "ee.vld.128.ip q7, %[mask], 16\n"
+                    "loopnez %[vectors], 1f\n"
+                    "ee.vld.128.ip q0, %[in], 16\n"
+                    "ee.vsr.32 q1, q0\n"
+                    "ee.vsl.32 q2, q0\n"
+                    "ee.andq q1, q1, q6\n"
+                    "ee.andq q2, q2, q7\n"
+                    "ee.orq q1, q1, q2\n"
+                    "ee.vst.128.ip q1, %[out], 16\n"
+                    "1:\n"
+                    : [mask] "+r" (mask), [in] "+r" (in), [out] "+r" (out)
+                    : [vectors] "r" (vectors)
+                    : "sar", "memory"
+                );
+            }
+            const size_t done = vectors * PIEPixels;
+            _copySwappedScalar(dst + done, src + done, count - done);
+        }
+# endif
+    };
+
+# if defined(EWM_NATIVE_CANVAS)
+    /**
+     * 16-bit 565 RGB canvas backed by a plain memory buffer, whose rows are getStride()
+     * pixels apart. Implements the subset of the Adafruit GFX canvas interface that
+     * Exostra and its themes rely upon, using the same rasterization algorithms.
+     *
+     * Only GFXfont fonts are supported; with no font set, text is not drawn.
+     */
+    class Canvas16
+    {
+    public:
+        Canvas16() = delete;
+
+        Canvas16(Extent width, Extent height)
+            : _buffer(new Color[static_cast<size_t>(width) * height]()), _owned(true),
+              _width(width), _height(height), _stride(width)
+        {
+        }
+
+        Canvas16(Color* buffer, Extent stride, Extent width, Extent height)
+            : _buffer(buffer), _owned(false), _width(width), _height(height),
+              _stride(stride)
+        {
+            EWM_ASSERT(_stride >= _width);
+        }
+
+        Canvas16(const Canvas16&) = delete;
+        Canvas16& operator=(const Canvas16&) = delete;
+
+        virtual ~Canvas16()
+        {
+            if (_owned) {
+                delete[] _buffer;
+            }
+        }
+
+        Extent width() const noexcept { return _width; }
+        Extent height() const noexcept { return _height; }
+        Extent getStride() const noexcept { return _stride; }
+        Color* getBuffer() const noexcept { return _buffer; }
+
+        /**
+         * Returns the address of the pixel at x, y; the width() - x pixels to its right
+         * follow it in memory.
+         */
+        Color* getSpan(Coord x, Coord y) const noexcept
+        {
+            EWM_ASSERT(x >= 0 && y >= 0 && x <= _width && y <= _height);
+            return _buffer + (static_cast<size_t>(y) * _stride) + x;
+        }
+
+        virtual void drawPixel(Coord x, Coord y, Color color) noexcept
+        {
+            if (x >= 0 && y >= 0 && x < _width && y < _height) {
+                _buffer[(y * _stride) + x] = color;
+            }
+        }
+
+        void drawFastHLine(Coord x, Coord y, Coord w, Color color) noexcept
+        {
+            fillRect(x, y, w, 1, color);
+        }
+
+        void drawFastVLine(Coord x, Coord y, Coord h, Color color) noexcept
+        {
+            fillRect(x, y, 1, h, color);
+        }
+
+        virtual void fillRect(Coord x, Coord y, Coord w, Coord h, Color color) noexcept
+        {
+            int x0 = max(0, static_cast<int>(x));
+            int y0 = max(0, static_cast<int>(y));
+            int x1 = min(static_cast<int>(_width), x + w);
+            int y1 = min(static_cast<int>(_height), y + h);
+            if (x0 >= x1 || y0 >= y1) {
+                return;
+            }
+            PixelKernels::fillRect(getSpan(x0, y0), _stride, x1 - x0, y1 - y0, color);
+        }
+
+        void fillScreen(Color color) noexcept
+        {
+            fillRect(0, 0, _width, _height, color);
+        }
+
+        /**
+         * Draws the frame of a rounded rect, thickness pixels wide, in a single pass: each
+         * row is one or two spans.
+         */
+        void drawRoundFrame(Coord x, Coord y, Coord w, Coord h, Coord r, Coord thickness,
+            Color color) noexcept
+        {
+            r = min(r, static_cast<Coord>(min(w, h) / 2));
+            const Coord innerW = w - (2 * thickness);
+            const Coord innerH = h - (2 * thickness);
+            if (innerW <= 0 || innerH <= 0) {
+                fillRoundRect(x, y, w, h, r, color);
+                return;
+            }
+            const Coord innerR = min(r, static_cast<Coord>(min(innerW, innerH) / 2));
+            // Looking up the inner arc may evict the outer one from the cache.
+            std::array<uint8_t, EWM_MAX_ARC_RADIUS> outerArc;
+            const uint8_t* arc = _getArc(r);
+            if (arc != nullptr) {
+                std::memcpy(outerArc.data(), arc, outerArc.size());
+                arc = outerArc.data();
+            }
+            const uint8_t* innerArc = _getArc(innerR);
+            if (arc == nullptr || innerArc == nullptr) {
+                for (Coord idx = 0; idx < thickness; idx++) {
+                    drawRoundRect(x + idx, y + idx, w - (2 * idx), h - (2 * idx), r, color);
+                }
+                return;
+            }
+            const auto bounds = _getDrawBounds();
+            const int top    = max(static_cast<int>(y), static_cast<int>(bounds.top));
+            const int bottom = min(y + h, static_cast<int>(bounds.bottom));
+            for (int row = top; row < bottom; row++) {
+                const Coord inset = _getInset(arc, r, h, row - y);
+                const Coord left  = x + inset;
+                const Coord right = x + w - inset;
+                if (row < y + thickness || row >= y + thickness + innerH) {
+                    fillRect(left, row, right - left, 1, color);
+                    continue;
+                }
+                const Coord innerInset = _getInset(innerArc, innerR, innerH, row - y - thickness);
+                const Coord innerLeft  = x + thickness + innerInset;
+                const Coord innerRight = x + thickness + innerW - innerInset;
+                fillRect(left, row, innerLeft - left, 1, color);
+                fillRect(innerRight, row, right - innerRight, 1, color);
+            }
+        }
+
+        void drawLine(Coord x0, Coord y0, Coord x1, Coord y1, Color color) noexcept
+        {
+            if (x0 == x1) {
+                drawFastVLine(x0, min(y0, y1), abs(y1 - y0) + 1, color);
+                return;
+            }
+            if (y0 == y1) {
+                drawFastHLine(min(x0, x1), y0, abs(x1 - x0) + 1, color);
+                return;
+            }
+            const bool steep = abs(y1 - y0) > abs(x1 - x0);
+            if (steep) {
+                std::swap(x0, y0);
+                std::swap(x1, y1);
+            }
+            if (x0 > x1) {
+                std::swap(x0, x1);
+                std::swap(y0, y1);
+            }
+            const int dx   = x1 - x0;
+            const int dy   = abs(y1 - y0);
+            const int step = y0 < y1 ? 1 : -1;
+            int err = dx / 2;
+            // Pixels that share a row (or a column, if steep) are drawn as one span.
+            int runStart = x0;
+            for (int x = x0, y = y0; x <= x1; x++) {
+                err -= dy;
+                if (err < 0 || x == x1) {
+                    if (steep) {
+                        fillRect(y, runStart, 1, x - runStart + 1, color);
+                    } else {
+                        fillRect(runStart, y, x - runStart + 1, 1, color);
+                    }
+                    runStart = x + 1;
+                }
+                if (err < 0) {
+                    y   += step;
+                    err += dx;
+                }
+            }
+        }
+
+        void drawRoundRect(Coord x, Coord y, Coord w, Coord h, Coord r, Color color) noexcept
+        {
+            r = min(r, static_cast<Coord>(min(w, h) / 2));
+            drawFastHLine(x + r, y, w - (2 * r), color);
+            drawFastHLine(x + r, y + h - 1, w - (2 * r), color);
+            drawFastVLine(x, y + r, h - (2 * r), color);
+            drawFastVLine(x + w - 1, y + r, h - (2 * r), color);
+            drawCircleHelper(x + r, y + r, r, 1, color);
+            drawCircleHelper(x + w - r - 1, y + r, r, 2, color);
+            drawCircleHelper(x + w - r - 1, y + h - r - 1, r, 4, color);
+            drawCircleHelper(x + r, y + h - r - 1, r, 8, color);
+        }
+
+        void fillRoundRect(Coord x, Coord y, Coord w, Coord h, Coord r, Color color) noexcept
+        {
+            r = min(r, static_cast<Coord>(min(w, h) / 2));
+            if (const uint8_t* arc = _getArc(r)) {
+                const auto bounds = _getDrawBounds();
+                const int top    = max(static_cast<int>(y), static_cast<int>(bounds.top));
+                const int bottom = min(y + h, static_cast<int>(bounds.bottom));
+                for (int row = top; row < bottom; row++) {
+                    const Coord inset = _getInset(arc, r, h, row - y);
+                    fillRect(x + inset, row, w - (2 * inset), 1, color);
+                }
+                return;
+            }
+            fillRect(x + r, y, w - (2 * r), h, color);
+            fillCircleHelper(x + w - r - 1, y + r, r, 1, h - (2 * r) - 1, color);
+            fillCircleHelper(x + r, y + r, r, 2, h - (2 * r) - 1, color);
+        }
+
+        void setTextSize(uint8_t size) noexcept { _textSize = max(uint8_t(1), size); }
+        void setFont(const GFXfont* font) noexcept { _font = font; }
+
+        void drawChar(Coord x, Coord y, unsigned char ch, Color color,
+            [[maybe_unused]] Color bg, uint8_t size) noexcept
+        {
+            const GFXglyph* glyph = _getGlyph(ch);
+            if (glyph == nullptr) {
+                return;
+            }
+            const uint8_t* bitmap = _font->bitmap;
+            uint16_t offset = glyph->bitmapOffset;
+            uint8_t bits    = 0;
+            uint8_t bit     = 0;
+            for (int yy = 0; yy < glyph->height; yy++) {
+                // Runs of set bits in a row are drawn as one span.
+                int runStart = -1;
+                for (int xx = 0; xx <= glyph->width; xx++) {
+                    bool set = false;
+                    if (xx < glyph->width) {
+                        if (!(bit++ & 7)) {
+                            bits = bitmap[offset++];
+                        }
+                        set = (bits & 0x80) != 0;
+                        bits <<= 1;
+                    }
+                    if (set && runStart < 0) {
+                        runStart = xx;
+                    } else if (!set && runStart >= 0) {
+                        fillRect(x + ((glyph->xOffset + runStart) * size),
+                            y + ((glyph->yOffset + yy) * size), (xx - runStart) * size, size,
+                            color);
+                        runStart = -1;
+                    }
+                }
+            }
+        }
+
+        void getTextBounds(const char* str, Coord x, Coord y, Coord* x1, Coord* y1,
+            Extent* w, Extent* h) const noexcept
+        {
+            *x1 = x;
+            *y1 = y;
+            *w  = 0;
+            *h  = 0;
+            if (_font == nullptr) {
+                return;
+            }
+            int minX = INT16_MAX, minY = INT16_MAX, maxX = -1, maxY = -1;
+            int curX = x, curY = y;
+            for (; *str != '\0'; str++) {
+                if (*str == '\n') {
+                    curX = 0;
+                    curY += _textSize * _font->yAdvance;
+                    continue;
+                }
+                const GFXglyph* glyph = _getGlyph(static_cast<unsigned char>(*str));
+                if (glyph == nullptr) {
+                    continue;
+                }
+                const int gx1 = curX + (glyph->xOffset * _textSize);
+                const int gy1 = curY + (glyph->yOffset * _textSize);
+                const int gx2 = gx1 + (glyph->width * _textSize) - 1;
+                const int gy2 = gy1 + (glyph->height * _textSize) - 1;
+                minX = min(minX, gx1);
+                minY = min(minY, gy1);
+                maxX = max(maxX, gx2);
+                maxY = max(maxY, gy2);
+                curX += glyph->xAdvance * _textSize;
+            }
+            if (maxX >= minX) {
+                *x1 = minX;
+                *w  = maxX - minX + 1;
+            }
+            if (maxY >= minY) {
+                *y1 = minY;
+                *h  = maxY - minY + 1;
+            }
+        }
+
+    protected:
+        void _setBuffer(Color* buffer) noexcept
+        {
+            EWM_ASSERT(!_owned);
+            _buffer = buffer;
+        }
+
+        /** Returns the rect (in drawing coordinates) outside of which nothing is drawn. */
+        virtual Rect _getDrawBounds() const noexcept
+        {
+            return Rect(0, 0, _width, _height);
+        }
+
+    private:
+        EWM_CONST(size_t, ArcCacheSlots, 4);
+
+        /**
+         * For each row of a corner of radius r (top row first), the number of pixels
+         * at its edge that are outside of the arc.
+         */
+        struct Arc
+        {
+            Coord radius = -1;
+            std::array<uint8_t, EWM_MAX_ARC_RADIUS> insets {};
+        };
+
+        /**
+         * Returns the arc of radius r (computed once, then cached), or nullptr if r is
+         * too large.
+         */
+        static const uint8_t* _getArc(Coord r) noexcept
+        {
+            if (r < 0 || r > EWM_MAX_ARC_RADIUS) {
+                return nullptr;
+            }
+            static std::array<Arc, ArcCacheSlots> cache;
+            static size_t next = 0;
+            for (const auto& arc : cache) {
+                if (arc.radius == r) {
+                    return arc.insets.data();
+                }
+            }
+            auto& arc = cache[next];
+            next = (next + 1) % ArcCacheSlots;
+            _computeArc(r, arc.insets.data());
+            arc.radius = r;
+            return arc.insets.data();
+        }
+
+        /**
+         * Computes the insets of an arc such that the spans cover exactly the pixels
+         * that fillCircleHelper() does, i.e. matches Adafruit GFX's fillRoundRect().
+         */
+        static void _computeArc(Coord r, uint8_t* insets) noexcept
+        {
+            // How far above (and below) the center of the corner each column extends.
+            std::array<int, EWM_MAX_ARC_RADIUS + 1> extents;
+            extents.fill(-1);
+            int f     = 1 - r;
+            int ddF_x = 1;
+            int ddF_y = -2 * r;
+            int x     = 0;
+            int y     = r;
+            int px    = x;
+            int py    = y;
+            while (x < y) {
+                if (f >= 0) {
+                    y--;
+                    ddF_y += 2;
+                    f     += ddF_y;
+                }
+                x++;
+                ddF_x += 2;
+                f     += ddF_x;
+                if (x < (y + 1)) {
+                    extents[x] = max(extents[x], y);
+                }
+                if (y != py) {
+                    extents[py] = max(extents[py], px);
+                    py = y;
+                }
+                px = x;
+            }
+            for (int row = 0; row < r; row++) {
+                int reach = 0;
+                for (int column = r; column > 0; column--) {
+                    if (extents[column] >= r - row) {
+                        reach = column;
+                        break;
+                    }
+                }
+                insets[row] = static_cast<uint8_t>(r - reach);
+            }
+        }
+
+        /** Returns the inset of the given row of a rect h rows tall with radius r. */
+        static Coord _getInset(const uint8_t* arc, Coord r, Coord h, int row) noexcept
+        {
+            if (row < r) {
+                return arc[row];
+            }
+            if (row >= h - r) {
+                return arc[h - 1 - row];
+            }
+            return 0;
+        }
+
+        const GFXglyph* _getGlyph(unsigned char ch) const noexcept
+        {
+            if (_font == nullptr || ch < _font->first || ch > _font->last) {
+                return nullptr;
+            }
+            return _font->glyph + (ch - _font->first);
+        }
+
+        void drawCircleHelper(Coord x0, Coord y0, Coord r, uint8_t corners, Color color) noexcept
+        {
+            int f     = 1 - r;
+            int ddF_x = 1;
+            int ddF_y = -2 * r;
+            int x     = 0;
+            int y     = r;
+            while (x < y) {
+                if (f >= 0) {
+                    y--;
+                    ddF_y += 2;
+                    f     += ddF_y;
+                }
+                x++;
+                ddF_x += 2;
+                f     += ddF_x;
+                if (corners & 0x4) {
+                    drawPixel(x0 + x, y0 + y, color);
+                    drawPixel(x0 + y, y0 + x, color);
+                }
+                if (corners & 0x2) {
+                    drawPixel(x0 + x, y0 - y, color);
+                    drawPixel(x0 + y, y0 - x, color);
+                }
+                if (corners & 0x8) {
+                    drawPixel(x0 - y, y0 + x, color);
+                    drawPixel(x0 - x, y0 + y, color);
+                }
+                if (corners & 0x1) {
+                    drawPixel(x0 - y, y0 - x, color);
+                    drawPixel(x0 - x, y0 - y, color);
+                }
+            }
+        }
+
+        void fillCircleHelper(Coord x0, Coord y0, Coord r, uint8_t corners, Coord delta,
+            Color color) noexcept
+        {
+            int f     = 1 - r;
+            int ddF_x = 1;
+            int ddF_y = -2 * r;
+            int x     = 0;
+            int y     = r;
+            int px    = x;
+            int py    = y;
+            delta++;
+            while (x < y) {
+                if (f >= 0) {
+                    y--;
+                    ddF_y += 2;
+                    f     += ddF_y;
+                }
+                x++;
+                ddF_x += 2;
+                f     += ddF_x;
+                if (x < (y + 1)) {
+                    if (corners & 1) { drawFastVLine(x0 + x, y0 - y, (2 * y) + delta, color); }
+                    if (corners & 2) { drawFastVLine(x0 - x, y0 - y, (2 * y) + delta, color); }
+                }
+                if (y != py) {
+                    if (corners & 1) { drawFastVLine(x0 + py, y0 - px, (2 * px) + delta, color); }
+                    if (corners & 2) { drawFastVLine(x0 - py, y0 - px, (2 * px) + delta, color); }
+                    py = y;
+                }
+                px = x;
+            }
+        }
+
+        Color* _buffer         = nullptr;
+        bool _owned            = false;
+        Extent _width          = 0;
+        Extent _height         = 0;
+        Extent _stride         = 0;
+        uint8_t _textSize      = 1;
+        const GFXfont* _font   = nullptr;
+    };
+# endif
+
+# if defined(EWM_GFX_FBDEV)
+    /** Formerly the fbdev-only canvas; kept for existing code. */
+    using FbCanvas16 = Canvas16;
+
+    /**
+     * Linux framebuffer (fbdev) display. Maps /dev/fbN into memory, so that flushing a
+     * window's off-screen buffer is a series of stride-aware memcpy() calls straight
+     * into video memory (16bpp), or a 565 -> 888 conversion (32bpp).
+     *
+     * Any regular file may stand in for the device (e.g. for headless testing); its
+     * geometry must then be supplied to the constructor, and it is resized to fit. With
+     * an empty path, the framebuffer is plain anonymous memory.
+     *
+     * Optionally, the framebuffer may hold two pages: one being scanned out (the front
+     * page, which getFramebuffer() and the drawing functions refer to), and one that
+     * may be composed into before flip() makes it the front page.
+     */
+    class FbDisplay
+    {
+    public:
+        EWM_CONST(const char*, DefaultDevice, "/dev/fb0");
+
+        explicit FbDisplay(const char* path = DefaultDevice) : _path(path)
+        {
+        }
+
+        FbDisplay(const char* path, Extent width, Extent height, uint8_t bpp = 16)
+            : _path(path), _width(width), _height(height), _bpp(bpp), _fileBacked(true)
+        {
+        }
+
+        FbDisplay(const FbDisplay&) = delete;
+        FbDisplay& operator=(const FbDisplay&) = delete;
+
+        virtual ~FbDisplay()
+        {
+            end();
+        }
+
+        /** Requests a number of pages (1 or 2). Must be called before begin(). */
+        void setPageCount(uint8_t pages) noexcept
+        {
+            EWM_ASSERT(_fb == nullptr);
+            _pages = max(uint8_t(1), min(uint8_t(2), pages));
+        }
+
+        bool begin()
+        {
+            if (_fb != nullptr) {
+                return true;
+            }
+            if (_path.empty()) {
+                _lineLength = static_cast<size_t>(_width) * (_bpp / 8);
+                _pageLength = _lineLength * _height;
+                _mapLength  = _pageLength * _pages;
+                void* fb = mmap(nullptr, _mapLength, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (fb == MAP_FAILED || (_bpp != 16 && _bpp != 32)) {
+                    EWM_LOG_E("failed to allocate %hux%hu, %hhubpp framebuffer", _width,
+                        _height, _bpp);
+                    if (fb != MAP_FAILED) {
+                        munmap(fb, _mapLength);
+                    }
+                    return false;
+                }
+                _fb = static_cast<uint8_t*>(fb);
+                return true;
+            }
+            // Only a file standing in for the device (whose geometry was supplied) is
+            // created if missing; a mistyped device path must not leave a file behind.
+            _fd = _fileBacked ? open(_path.c_str(), O_RDWR | O_CREAT, 0644)
+                              : open(_path.c_str(), O_RDWR);
+            if (_fd < 0) {
+                EWM_LOG_E("failed to open '%s': %s", _path.c_str(), strerror(errno));
+                return false;
+            }
+            struct stat st {};
+            if (fstat(_fd, &st) != 0) {
+                EWM_LOG_E("failed to stat '%s': %s", _path.c_str(), strerror(errno));
+                end();
+                return false;
+            }
+            if (S_ISCHR(st.st_mode)) {
+                fb_var_screeninfo vinfo {};
+                fb_fix_screeninfo finfo {};
+                if (ioctl(_fd, FBIOGET_VSCREENINFO, &vinfo) != 0 ||
+                    ioctl(_fd, FBIOGET_FSCREENINFO, &finfo) != 0) {
+                    EWM_LOG_E("'%s' is not a framebuffer device", _path.c_str());
+                    end();
+                    return false;
+                }
+                if (_pages > 1 && vinfo.yres_virtual < vinfo.yres * _pages) {
+                    vinfo.yres_virtual = vinfo.yres * _pages;
+                    if (ioctl(_fd, FBIOPUT_VSCREENINFO, &vinfo) != 0 ||
+                        ioctl(_fd, FBIOGET_VSCREENINFO, &vinfo) != 0 ||
+                        ioctl(_fd, FBIOGET_FSCREENINFO, &finfo) != 0 ||
+                        vinfo.yres_virtual < vinfo.yres * _pages) {
+                        EWM_LOG_W("'%s' does not support page flipping", _path.c_str());
+                        _pages = 1;
+                    }
+                }
+                _width      = vinfo.xres;
+                _height     = vinfo.yres;
+                _bpp        = vinfo.bits_per_pixel;
+                _lineLength = finfo.line_length;
+                _pageLength = _lineLength * _height;
+                _mapLength  = finfo.smem_len;
+                _redShift   = vinfo.red.offset;
+                _greenShift = vinfo.green.offset;
+                _blueShift  = vinfo.blue.offset;
+                _vinfo      = vinfo;
+            } else {
+                _lineLength = static_cast<size_t>(_width) * (_bpp / 8);
+                _pageLength = _lineLength * _height;
+                _mapLength  = _pageLength * _pages;
+                if (static_cast<size_t>(st.st_size) < _mapLength &&
+                    ftruncate(_fd, _mapLength) != 0) {
+                    EWM_LOG_E("failed to resize '%s': %s", _path.c_str(), strerror(errno));
+                    end();
+                    return false;
+                }
+            }
+            if ((_bpp != 16 && _bpp != 32) || _mapLength < _pageLength * _pages) {
+                EWM_LOG_E("unsupported framebuffer: %hux%hu, %hhubpp", _width, _height, _bpp);
+                end();
+                return false;
+            }
+            void* fb = mmap(nullptr, _mapLength, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+            if (fb == MAP_FAILED) {
+                EWM_LOG_E("failed to map '%s': %s", _path.c_str(), strerror(errno));
+                end();
+                return false;
+            }
+            _fb = static_cast<uint8_t*>(fb);
+            EWM_LOG_D("mapped '%s': %hux%hu, %hhubpp, stride: %zu", _path.c_str(),
+                _width, _height, _bpp, _lineLength);
+            return true;
+        }
+
+        void end() noexcept
+        {
+            if (_fb != nullptr) {
+                munmap(_fb, _mapLength);
+                _fb = nullptr;
+            }
+            _front = 0;
+            if (_fd >= 0) {
+                close(_fd);
+                _fd = -1;
+            }
+        }
+
+        Extent width() const noexcept { return _width; }
+        Extent height() const noexcept { return _height; }
+
+        uint8_t* getFramebuffer() const noexcept { return getPage(_front); }
+        size_t getLineLength() const noexcept { return _lineLength; }
+        uint8_t getBitsPerPixel() const noexcept { return _bpp; }
+
+        uint8_t getPageCount() const noexcept { return _pages; }
+        uint8_t getFrontPage() const noexcept { return _front; }
+
+        uint8_t* getPage(uint8_t page) const noexcept
+        {
+            EWM_ASSERT(page < _pages);
+            return _fb != nullptr ? _fb + (page * _pageLength) : nullptr;
+        }
+
+        /** Makes the back page the front page. */
+        bool flip() noexcept
+        {
+            if (_pages < 2 || _fb == nullptr) {
+                return false;
+            }
+            const uint8_t back = _front ^ 1;
+            if (_fd >= 0 && _vinfo.yres != 0) {
+                _vinfo.yoffset = _vinfo.yres * back;
+                if (ioctl(_fd, FBIOPAN_DISPLAY, &_vinfo) != 0) {
+                    EWM_LOG_E("failed to pan '%s': %s", _path.c_str(), strerror(errno));
+                    return false;
+                }
+            }
+            _front = back;
+            return true;
+        }
+
+        void setRotation(uint8_t rotation) noexcept
+        {
+            if (rotation != 0) {
+                EWM_LOG_W("rotation %hhu unsupported; use the fbcon rotation instead", rotation);
+            }
+        }
+
+        void setCursor([[maybe_unused]] Coord x, [[maybe_unused]] Coord y) noexcept
+        {
+        }
+
+        void fillRect(Coord x, Coord y, Coord w, Coord h, Color color) noexcept
+        {
+            if (!_clip(x, y, w, h)) {
+                return;
+            }
+            if (_bpp == 16) {
+                PixelKernels::fillRect(_line16(y) + x, _lineLength / sizeof(Color), w, h,
+                    color);
+                return;
+            }
+            for (Coord row = y; row < y + h; row++) {
+                std::fill_n(_line32(row) + x, w, _to888(color));
+            }
+        }
+
+        void fillScreen(Color color) noexcept
+        {
+            fillRect(0, 0, _width, _height, color);
+        }
+
+        /**
+         * Copies a w x h block of 565 pixels at `src` (whose rows are `srcStride`
+         * pixels apart) to x,y on the display.
+         */
+        void writeRect(Coord x, Coord y, const Color* src, Extent srcStride, Coord w,
+            Coord h) noexcept
+        {
+            const Coord origX = x;
+            const Coord origY = y;
+            if (!_clip(x, y, w, h)) {
+                return;
+            }
+            src += ((y - origY) * srcStride) + (x - origX);
+            if (_bpp == 16) {
+                const size_t rowBytes = w * sizeof(Color);
+                if (x == 0 && w == srcStride && rowBytes == _lineLength) {
+                    PixelKernels::get().copy(_line16(y), src, static_cast<size_t>(w) * h);
+                    return;
+                }
+                PixelKernels::copyRect(_line16(y) + x, _lineLength / sizeof(Color), src,
+                    srcStride, w, h);
+            } else {
+                for (Coord row = 0; row < h; row++, src += srcStride) {
+                    uint32_t* dst = _line32(y + row) + x;
+                    for (Coord col = 0; col < w; col++) {
+                        dst[col] = _to888(src[col]);
+                    }
+                }
+            }
+        }
+
+    private:
+        bool _clip(Coord& x, Coord& y, Coord& w, Coord& h) const noexcept
+        {
+            if (_fb == nullptr) {
+                return false;
+            }
+            if (x < 0) { w += x; x = 0; }
+            if (y < 0) { h += y; y = 0; }
+            w = min(w, static_cast<Coord>(_width - x));
+            h = min(h, static_cast<Coord>(_height - y));
+            return w > 0 && h > 0;
+        }
+
+        Color* _line16(Coord row) const noexcept
+        {
+            return reinterpret_cast<Color*>(getFramebuffer() + (row * _lineLength));
+        }
+
+        uint32_t* _line32(Coord row) const noexcept
+        {
+            return reinterpret_cast<uint32_t*>(getFramebuffer() + (row * _lineLength));
+        }
+
+        uint32_t _to888(Color color) const noexcept
+        {
+            const uint32_t r = (color >> 11) & 0x1f;
+            const uint32_t g = (color >> 5) & 0x3f;
+            const uint32_t b = color & 0x1f;
+            return (((r << 3) | (r >> 2)) << _redShift) |
+                   (((g << 2) | (g >> 4)) << _greenShift) |
+                   (((b << 3) | (b >> 2)) << _blueShift);
+        }
+
+        std::string _path;
+        int _fd             = -1;
+        uint8_t* _fb        = nullptr;
+        size_t _mapLength   = 0;
+        size_t _pageLength  = 0;
+        size_t _lineLength  = 0;
+        fb_var_screeninfo _vinfo {};
+        Extent _width       = 0;
+        Extent _height      = 0;
+        uint8_t _bpp        = 16;
+        uint8_t _pages      = 1;
+        uint8_t _front      = 0;
+        uint8_t _redShift   = 16;
+        uint8_t _greenShift = 8;
+        uint8_t _blueShift  = 0;
+        bool _fileBacked    = false;
+    };
+# endif
+
+    inline Color* getGfxBuffer(const GfxContextPtr& ctx)
+    {
+# if defined(EWM_GFX_ADAFRUIT) || defined(EWM_NATIVE_CANVAS)
+        return ctx->getBuffer();
+# else
+        return ctx->getFramebuffer();
+# endif
+    }
+
+    /** Returns the number of pixels between the starts of two rows of a context. */
+    inline Extent getGfxStride(const GfxContextPtr& ctx)
+    {
+# if defined(EWM_NATIVE_CANVAS)
+        return ctx->getStride();
+# else
+        return static_cast<Extent>(ctx->width());
+# endif
+    }
+
+    /** Returns the address of the pixel at x, y of a context. */
+    inline Color* getGfxSpan(const GfxContextPtr& ctx, Coord x, Coord y)
+    {
+# if defined(EWM_NATIVE_CANVAS)
+        return ctx->getSpan(x, y);
+# else
+        return getGfxBuffer(ctx) + (static_cast<size_t>(y) * getGfxStride(ctx)) + x;
+# endif
+    }
+
+# if defined(EWM_STATIC_POOLS)
+    /** Static storage for the off-screen buffers that WindowManager::begin() sets up. */
+    class PixelPool
+    {
+    public:
+        EWM_CONST(size_t, Capacity, EWM_POOL_PIXELS);
+
+        /** Returns count pixels, or nullptr if the pool is exhausted. */
+        Color* allocate(size_t count) noexcept
+        {
+            if (count > Capacity - _used) {
+                return nullptr;
+            }
+            const auto pixels = _pixels.data() + _used;
+            _used += count;
+            return pixels;
+        }
+
+        void reset() noexcept { _used = 0; }
+        size_t available() const noexcept { return Capacity - _used; }
+
+    private:
+        std::array<Color, EWM_POOL_PIXELS> _pixels;
+        size_t _used = 0;
+    };
+
+    inline PixelPool& getPixelPool() noexcept
+    {
+        EWM_POOL_PIXELS_ATTR static PixelPool pool;
+        return pool;
+    }
+# endif
+
+    /** Creates an off-screen 565 canvas with a buffer of its own. */
+    inline GfxContextPtr createGfxContext(Extent width, Extent height)
+    {
+# if defined(EWM_GFX_ADAFRUIT) || defined(EWM_NATIVE_CANVAS)
+        return std::make_shared<GfxContext>(width, height);
+# else
+        auto ctx = std::make_shared<GfxContext>(width, height, nullptr, 0, 0);
+        EWM_ASSERT(ctx);
+        if (ctx) {
+            ctx->begin(GFX_SKIP_OUTPUT_BEGIN);
+        }
+        return ctx;
+# endif
+    }
+
+    /**
+     * Origin and clip rect of a view: drawing coordinates are offset by the origin,
+     * and anything falling outside of the clip rect (in target coordinates) is
+     * discarded. An empty clip rect discards everything.
+     */
+    class ViewTransform
+    {
+    public:
+        void setOrigin(Coord x, Coord y) noexcept { _origin = Point(x, y); }
+        Point getOrigin() const noexcept { return _origin; }
+
+        void setClipRect(const Rect& rect) noexcept { _clip = rect; }
+        Rect getClipRect() const noexcept { return _clip; }
+
+    protected:
+        /**
+         * Translates a rect from view to target coordinates and clips it. Returns false
+         * if nothing remains.
+         */
+        bool _transform(Coord& x, Coord& y, Coord& w, Coord& h) const noexcept
+        {
+            const int left   = max(static_cast<int>(_clip.left), x + _origin.x);
+            const int top    = max(static_cast<int>(_clip.top), y + _origin.y);
+            const int right  = min(static_cast<int>(_clip.right), x + _origin.x + w);
+            const int bottom = min(static_cast<int>(_clip.bottom), y + _origin.y + h);
+            if (left >= right || top >= bottom) {
+                return false;
+            }
+            x = left;
+            y = top;
+            w = right - left;
+            h = bottom - top;
+            return true;
+        }
+
+    private:
+        Point _origin;
+        Rect _clip;
+    };
+
+    /**
+     * Graphics context that draws, through a ViewTransform, either into a 565 buffer
+     * owned by someone else (a panel framebuffer, or a buffer shared by several
+     * windows), straight to the display, or into another context (a sub-view, such as
+     * a child window's view of its parent). A buffer's stride must equal its width in
+     * pixels.
+     */
+# if defined(EWM_NATIVE_CANVAS)
+    class GfxView : public GfxContext, public ViewTransform
+    {
+    public:
+        GfxView(Color* buffer, Extent stride, Extent height)
+            : GfxContext(buffer, stride, stride, height)
+        {
+        }
+
+        GfxView(GfxDisplay* display, Extent width, Extent height)
+            : GfxContext(nullptr, width, width, height), _display(display)
+        {
+            EWM_ASSERT(_display);
+        }
+
+        /** Non-owning; target must outlive the view. */
+        GfxView(GfxContext* target, Extent width, Extent height)
+            : GfxContext(nullptr, width, width, height), _target(target)
+        {
+            EWM_ASSERT(_target);
+        }
+
+        void setBuffer(Color* buffer) noexcept { _setBuffer(buffer); }
+
+        void drawPixel(Coord x, Coord y, Color color) noexcept override
+        {
+            fillRect(x, y, 1, 1, color);
+        }
+
+        void fillRect(Coord x, Coord y, Coord w, Coord h, Color color) noexcept override
+        {
+            if (!_transform(x, y, w, h)) {
+                return;
+            }
+            if (_target != nullptr) {
+                _target->fillRect(x, y, w, h, color);
+            } else if (_display != nullptr) {
+                _display->fillRect(x, y, w, h, color);
+            } else {
+                GfxContext::fillRect(x, y, w, h, color);
+            }
+        }
+
+    protected:
+        Rect _getDrawBounds() const noexcept override
+        {
+            const auto clip   = getClipRect();
+            const auto origin = getOrigin();
+            return Rect(clip.left - origin.x, clip.top - origin.y, clip.right - origin.x,
+                clip.bottom - origin.y);
+        }
+
+    private:
+        GfxDisplay* _display = nullptr;
+        GfxContext* _target  = nullptr;
+    };
+# elif defined(EWM_GFX_ADAFRUIT)
+    class GfxView : public GfxContext, public ViewTransform
+    {
+    public:
+        GfxView(Color* buffer, Extent stride, Extent height)
+            : GfxContext(stride, height, false)
+        {
+            setBuffer(buffer);
+        }
+
+        GfxView(GfxDisplay* display, Extent width, Extent height)
+            : GfxContext(width, height, false), _display(display)
+        {
+            EWM_ASSERT(_display);
+        }
+
+        /** Non-owning; target must outlive the view. */
+        GfxView(GfxContext* target, Extent width, Extent height)
+            : GfxContext(width, height, false), _target(target)
+        {
+            EWM_ASSERT(_target);
+        }
+
+        void setBuffer(Color* buffer) noexcept { this->buffer = buffer; }
+
+        void drawPixel(int16_t x, int16_t y, uint16_t color) override
+        {
+            Coord w = 1;
+            Coord h = 1;
+            if (!_transform(x, y, w, h)) {
+                return;
+            }
+            if (_target != nullptr) {
+                _target->drawPixel(x, y, color);
+            } else if (_display != nullptr) {
+                _display->drawPixel(x, y, color);
+            } else {
+                GfxContext::drawPixel(x, y, color);
+            }
+        }
+
+        void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override
+        {
+            fillRect(x, y, w, 1, color);
+        }
+
+        void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override
+        {
+            fillRect(x, y, 1, h, color);
+        }
+
+        void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override
+        {
+            if (!_transform(x, y, w, h)) {
+                return;
+            }
+            if (_target != nullptr) {
+                _target->fillRect(x, y, w, h, color);
+            } else if (_display != nullptr) {
+                _display->fillRect(x, y, w, h, color);
+            } else {
+                for (Coord row = y; row < y + h; row++) {
+                    GfxContext::drawFastHLine(x, row, w, color);
+                }
+            }
+        }
+
+        void fillScreen(uint16_t color) override
+        {
+            const auto clip = getClipRect();
+            fillRect(clip.left - getOrigin().x, clip.top - getOrigin().y, clip.width(),
+                clip.height(), color);
+        }
+
+    private:
+        GfxDisplay* _display = nullptr;
+        GfxContext* _target  = nullptr;
+    };
+# elif defined(EWM_GFX_ARDUINO)
+    class GfxView : public GfxContext, public ViewTransform
+    {
+    public:
+        GfxView(Color* buffer, Extent stride, Extent height)
+            : GfxContext(stride, height, nullptr)
+        {
+            setBuffer(buffer);
+        }
+
+        GfxView(GfxDisplay* display, Extent width, Extent height)
+            : GfxContext(width, height, nullptr), _display(display)
+        {
+            EWM_ASSERT(_display);
+        }
+
+        /** Non-owning; target must outlive the view. */
+        GfxView(GfxContext* target, Extent width, Extent height)
+            : GfxContext(width, height, nullptr), _target(target)
+        {
+            EWM_ASSERT(_target);
+        }
+
+        virtual ~GfxView()
+        {
+            // Keep Arduino_Canvas from freeing a buffer it does not own.
+            _framebuffer = nullptr;
+        }
+
+        void setBuffer(Color* buffer) noexcept { _framebuffer = buffer; }
+
+        void writePixel(int16_t x, int16_t y, uint16_t color) override
+        {
+            Coord w = 1;
+            Coord h = 1;
+            if (!_transform(x, y, w, h)) {
+                return;
+            }
+            if (_target != nullptr) {
+                _target->writePixel(x, y, color);
+            } else if (_display != nullptr) {
+                _display->drawPixel(x, y, color);
+            } else {
+                GfxContext::writePixel(x, y, color);
+            }
+        }
+
+        void writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override
+        {
+            writeFillRect(x, y, w, 1, color);
+        }
+
+        void writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override
+        {
+            writeFillRect(x, y, 1, h, color);
+        }
+
+        void writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override
+        {
+            if (!_transform(x, y, w, h)) {
+                return;
+            }
+            if (_target != nullptr) {
+                _target->writeFillRect(x, y, w, h, color);
+            } else if (_display != nullptr) {
+                _display->fillRect(x, y, w, h, color);
+            } else {
+                GfxContext::writeFillRect(x, y, w, h, color);
+            }
+        }
+
+    private:
+        GfxDisplay* _display = nullptr;
+        GfxContext* _target  = nullptr;
+    };
+# endif
+
+    using GfxViewPtr = std::shared_ptr<GfxView>;
+
+    /** Draws the frame of a rounded rect, thickness pixels wide. */
+    inline void drawRoundFrame(const GfxContextPtr& ctx, Coord x, Coord y, Coord w, Coord h,
+        Coord radius, Coord thickness, Color color)
+    {
+# if defined(EWM_NATIVE_CANVAS)
+        ctx->drawRoundFrame(x, y, w, h, radius, thickness, color);
+# else
+        for (Coord idx = 0; idx < thickness; idx++) {
+            ctx->drawRoundRect(x + idx, y + idx, w - (2 * idx), h - (2 * idx), radius, color);
+        }
+# endif
+    }
+
+    inline GFXglyph* getGlyphAtOffset(const GFXfont* font, uint8_t off)
+    {
+# ifdef __AVR__
+        return &((static_cast<GFXglyph*>(pgm_read_pointer(&font->glyph)))[off]);
+# else
+        return font->glyph + off;
+# endif
+    }
+
+    static void getCharBounds(uint8_t ch, uint8_t* cx, uint8_t* cy, uint8_t* xAdv,
+        uint8_t* yAdv, int8_t* xOff, int8_t* yOff, uint8_t textSize = 1,
+        const GFXfont* font = nullptr) noexcept
+    {
+        uint8_t first = font ? pgm_read_byte(&font->first) : 0;
+        bool okCh = font ? ch >= first && ch <= pgm_read_byte(&font->last) : false;
+        auto glyph = okCh ? getGlyphAtOffset(font, ch - first) : nullptr;
+        if (cx) { *cx = textSize * (font ? (okCh ? pgm_read_byte(&glyph->width) : 0) : 6); }
+        if (cy) { *cy = textSize * (font ? (okCh ? pgm_read_byte(&glyph->height) : 0) : 8); }
+        if (xAdv) { *xAdv = textSize * (okCh ? pgm_read_byte(&glyph->xAdvance) : 6); }
+        if (yAdv) { *yAdv = okCh ? pgm_read_byte(&font->yAdvance) : textSize * 8; }
+        if (xOff) { *xOff = okCh ? pgm_read_byte(&glyph->xOffset) : 0; }
+        if (yOff) { *yOff = okCh ? pgm_read_byte(&glyph->yOffset) : 0; }
+    }
+
+    template<typename T>
+    constexpr T operator&(const T& t1, const T& t2)
+    {
+        return static_cast<T>(
+            static_cast<unsigned>(t1) & static_cast<unsigned>(t2)
+        );
+    }
+
+    template<typename T>
+    constexpr T operator|(const T& t1, const T& t2)
+    {
+        return static_cast<T>(
+            static_cast<unsigned>(t1) | static_cast<unsigned>(t2)
+        );
+    }
+
+    template<typename T>
+    T constexpr operator~(const T& t1)
+    {
+        return static_cast<T>(
+            ~static_cast<unsigned>(t1)
+        );
+    }
+
+    template<typename T1, typename T2>
+    inline bool bitsHigh(const T1& bitmask, const T2& bits) noexcept
+    {
+        return (bitmask & bits) == bits;
+    }
+
+    using Mutex     = std::recursive_mutex;
+    using ScopeLock = std::scoped_lock<Mutex>;
+
+# if defined(EWM_STATIC_POOLS)
+    /**
+     * Fixed-capacity sequence, providing the subset of the std::vector/std::deque
+     * interface used here. push_back() returns false once full.
+     */
+    template<typename T, size_t N>
+    class StaticVector
+    {
+    public:
+        using value_type             = T;
+        using iterator               = T*;
+        using const_iterator         = const T*;
+        using reverse_iterator       = std::reverse_iterator<iterator>;
+        using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+        static constexpr size_t capacity() noexcept { return N; }
+
+        bool empty() const noexcept { return _count == 0; }
+        bool full() const noexcept { return _count == N; }
+        size_t size() const noexcept { return _count; }
+
+        iterator begin() noexcept { return _items.data(); }
+        iterator end() noexcept { return _items.data() + _count; }
+        const_iterator begin() const noexcept { return _items.data(); }
+        const_iterator end() const noexcept { return _items.data() + _count; }
+        const_iterator cbegin() const noexcept { return begin(); }
+        const_iterator cend() const noexcept { return end(); }
+        reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
+        reverse_iterator rend() noexcept { return reverse_iterator(begin()); }
+        const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+        const_reverse_iterator rend() const noexcept { return const_reverse_iterator(begin()); }
+
+        T& operator[](size_t idx) noexcept
+        {
+            EWM_ASSERT(idx < _count);
+            return _items[idx];
+        }
+
+        const T& operator[](size_t idx) const noexcept
+        {
+            EWM_ASSERT(idx < _count);
+            return _items[idx];
+        }
+
+        T& at(size_t idx) noexcept { return (*this)[idx]; }
+
+        bool push_back(const T& value)
+        {
+            if (full()) {
+                return false;
+            }
+            _items[_count++] = value;
+            return true;
+        }
+
+        void pop_back()
+        {
+            EWM_ASSERT(!empty());
+            _items[--_count] = T();
+        }
+
+        iterator erase(iterator it)
+        {
+            EWM_ASSERT(it >= begin() && it < end());
+            std::move(it + 1, end(), it);
+            pop_back();
+            return it;
+        }
+
+        void clear()
+        {
+            while (!empty()) {
+                pop_back();
+            }
+        }
+
+    private:
+        std::array<T, N> _items {};
+        size_t _count = 0;
+    };
+
+    /** Fixed-capacity FIFO queue. push() returns false once full. */
+    template<typename T, size_t N>
+    class StaticQueue
+    {
+    public:
+        bool empty() const noexcept { return _count == 0; }
+        bool full() const noexcept { return _count == N; }
+        size_t size() const noexcept { return _count; }
+
+        const T& front() const noexcept
+        {
+            EWM_ASSERT(!empty());
+            return _items[_head];
+        }
+
+        bool push(const T& value)
+        {
+            if (full()) {
+                return false;
+            }
+            _items[(_head + _count) % N] = value;
+            _count++;
+            return true;
+        }
+
+        void pop()
+        {
+            EWM_ASSERT(!empty());
+            _items[_head] = T();
+            _head = (_head + 1) % N;
+            _count--;
+        }
+
+    private:
+        std::array<T, N> _items {};
+        size_t _head  = 0;
+        size_t _count = 0;
+    };
+
+    /** Statically allocated pool of BlockCount fixed-size blocks. */
+    template<size_t BlockSize, size_t BlockCount>
+    class BlockPool
+    {
+    public:
+        EWM_CONST(size_t, Size, BlockSize);
+        EWM_CONST(size_t, Count, BlockCount);
+
+        BlockPool() noexcept
+        {
+            for (size_t idx = 0; idx < BlockCount; idx++) {
+                _free[idx] = BlockCount - idx - 1;
+            }
+        }
+
+        /** Returns a block, or nullptr if the pool is exhausted. */
+        void* allocate() noexcept
+        {
+            ScopeLock lock(_mtx);
+            if (_freeCount == 0) {
+                return nullptr;
+            }
+            return _blocks[_free[--_freeCount]].bytes;
+        }
+
+        void deallocate(void* ptr) noexcept
+        {
+            ScopeLock lock(_mtx);
+            const auto block = reinterpret_cast<Block*>(ptr);
+            EWM_ASSERT(block >= _blocks.data() && block < _blocks.data() + BlockCount);
+            EWM_ASSERT(_freeCount < BlockCount);
+            _free[_freeCount++] = static_cast<size_t>(block - _blocks.data());
+        }
+
+        size_t available() const noexcept
+        {
+            ScopeLock lock(_mtx);
+            return _freeCount;
+        }
+
+    private:
+        struct alignas(std::max_align_t) Block
+        {
+            unsigned char bytes[BlockSize];
+        };
+
+        std::array<Block, BlockCount> _blocks;
+        std::array<size_t, BlockCount> _free;
+        size_t _freeCount = BlockCount;
+        mutable Mutex _mtx;
+    };
+
+    /**
+     * Allocator (for std::allocate_shared) that takes single objects from a BlockPool.
+     * Callers must check BlockPool::available() first: there is no way to report an
+     * exhausted pool from here without exceptions.
+     */
+    template<typename T, typename TPool>
+    class PoolAllocator
+    {
+    public:
+        using value_type = T;
+
+        explicit PoolAllocator(TPool& pool) noexcept : _pool(&pool) {}
+
+        template<typename U>
+        PoolAllocator(const PoolAllocator<U, TPool>& other) noexcept : _pool(other.getPool()) {}
+
+        T* allocate(size_t count)
+        {
+            static_assert(sizeof(T) <= TPool::Size, "pool block size is too small");
+            static_assert(alignof(T) <= alignof(std::max_align_t));
+            EWM_ASSERT(count == 1);
+            const auto ptr = _pool->allocate();
+            EWM_ASSERT(ptr != nullptr);
+            return static_cast<T*>(ptr);
+        }
+
+        void deallocate(T* ptr, [[maybe_unused]] size_t count) noexcept
+        {
+            _pool->deallocate(ptr);
+        }
+
+        TPool* getPool() const noexcept { return _pool; }
+
+        template<typename U>
+        bool operator==(const PoolAllocator<U, TPool>& rhs) const noexcept
+        {
+            return _pool == rhs.getPool();
+        }
+
+        template<typename U>
+        bool operator!=(const PoolAllocator<U, TPool>& rhs) const noexcept
+        {
+            return _pool != rhs.getPool();
+        }
+
+    private:
+        TPool* _pool = nullptr;
+    };
+
+    using WindowPool = BlockPool<EWM_POOL_WINDOW_SIZE, EWM_POOL_WINDOWS>;
+    using WMPool     = BlockPool<EWM_POOL_WM_SIZE, 1>;
+
+    inline WindowPool& getWindowPool() noexcept
+    {
+        static WindowPool pool;
+        return pool;
+    }
+
+    inline WMPool& getWMPool() noexcept
+    {
+        static WMPool pool;
+        return pool;
+    }
+# endif
+
+    enum class Message : uint8_t
+    {
+        None     = 0,
+        Create   = 1,
+        Destroy  = 2,
+        Draw     = 3,
+        PostDraw = 4,
+        Input    = 5,
+        Event    = 6,
+        Resize   = 7
+    };
+
+    enum class Style : uint32_t
+    {
+        None       = 0,
+        Visible    =  1 << 0,
+        Child      =  1 << 1,
+        Frame      =  1 << 2,
+        Shadow     =  1 << 3,
+        TopLevel   = (1 << 4) | Frame | Shadow,
+        AutoSize   =  1 << 5,
+        FullScreen =  1 << 6,
+        Button     =  1 << 7,
+        Label      =  1 << 8,
+        Prompt     =  (1 << 9) | TopLevel,
+        Progress   =  1 << 10,
+        CheckBox   =  1 << 11,
+        Opaque     =  1 << 12  /**< Hint: paints every pixel of its rect (if square-cornered). */
+    };
+
+    enum class State : uint16_t
+    {
+        None    = 0,      /**< Invalid state. */
+        Alive   = 1 << 0, /**< Active (not yet destroyed). */
+        Checked = 1 << 1, /**< Checked/highlighted item. */
+        Dirty   = 1 << 2, /**< Needs redrawing. */
+        Pressed = 1 << 3, /**< Pressed/tapped item. */
+        Drawn   = 1 << 4, /**< Drawn at least once (top-level windows only). */
+        Deferred = 1 << 5 /**< Draw postponed until the window is exposed (top-level windows only). */
+    };
+
+    enum class ProgressStyle : uint8_t
+    {
+        Normal        = 1 << 0, /**< Standard linear-fill progress bar. */
+        Indeterminate = 1 << 1  /**< Marquee-style progress bar. */
+    };
+
+    enum class DrawText : uint8_t
+    {
+        Center   = 1 << 0, /**< Horizontal align center. */
+        Single   = 1 << 1, /**< Single line of text. */
+        Clip     = 1 << 2, /**< Text outside the rect will not be drawn. */
+        Ellipsis = 1 << 3  /**< Replace clipped text with '...' */
+    };
+
+    enum class EventType : uint8_t
+    {
+        ChildTapped = 1
+    };
+
+    enum class InputType : uint8_t
+    {
+        None = 0,
+        Tap  = 1
+    };
+
+    struct InputParams
+    {
+# if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
+        std::string handledBy;
+# endif
+        InputType type = InputType::None;
+        Coord x = 0;
+        Coord y = 0;
+    };
+
+    static MsgParam makeMsgParam(const MsgParamWord& hiWord, const MsgParamWord& loWord)
+    {
+        return (static_cast<MsgParam>(hiWord) << 16) | (loWord & 0xffffU);
+    }
+
+    static MsgParamWord getMsgParamHiWord(const MsgParam& msgParam)
+    {
+        return ((msgParam >> 16) & 0xffffU);
+    }
+
+    static MsgParamWord getMsgParamLoWord(const MsgParam& msgParam)
+    {
+        return (msgParam & 0xffffU);
+    }
+
+    enum class ColorID : uint8_t
+    {
+        Screensaver = 1,
+
+        PromptBg,
+        PromptFrame,
+        PromptShadow,
+
+        WindowText,
+        WindowBg,
+        WindowFrame,
+        WindowShadow,
+
+        ButtonText,
+        ButtonTextPressed,
+        ButtonBg,
+        ButtonBgPressed,
+        ButtonFrame,
+        ButtonFramePressed,
+
+        ProgressBg,
+        ProgressFill,
+
+        CheckBoxCheckBg,
+        CheckBoxCheckFrame,
+        CheckBoxCheck
+    };
+
+    enum class MetricID : uint8_t
+    {
+        XPadding = 1,             /**< Extent */
+        YPadding,                 /**< Extent */
+
+        DefTextSize,              /**< uint8_t */
+
+        WindowFramePx,            /**< Extent */
+        CornerRadiusWindow,       /**< Coord */
+        CornerRadiusButton,       /**< Coord */
+        CornerRadiusPrompt,       /**< Coord */
+        CornerRadiusCheckBox,     /**< Coord */
+
+        DefButtonCX,              /**< Extent */
+        DefButtonCY,              /**< Extent */
+        ButtonLabelPadding,       /**< Extent */
+        ButtonTappedDuration,     /**< uint32_t */
+
+        MaxPromptCX,              /**< Extent */
+        MaxPromptCY,              /**< Extent */
+
+        DefProgressHeight,        /**< Extent */
+        ProgressMarqueeCXFactor,  /**< float */
+        ProgressMarqueeStep,      /**< float */
+
+        DefCheckBoxHeight,        /**< Extent */
+        CheckBoxCheckAreaPadding, /**< Extent */
+        CheckBoxCheckMarkPadding, /**< Extent */
+        CheckBoxCheckDelay        /**< uint32_t */
+    };
+
+    struct Variant
+    {
+        enum class Type : uint8_t
+        {
+            Empty  = 0,
+            Extent = 1,
+            Coord  = 2,
+            UInt8  = 3,
+            UInt32 = 4,
+            Float  = 5
+        };
+
+        Variant() = default;
+
+        Type getType() const noexcept { return _type; }
+
+        Extent getExtent() const noexcept
+        {
+            EWM_ASSERT(_type == Type::Extent);
+            return _extentValue;
+        }
+
+        void setExtent(const Extent& extent) noexcept
+        {
+            _extentValue = extent;
+            _type = Type::Extent;
+        }
+
+        Coord getCoord() const noexcept
+        {
+            EWM_ASSERT(_type == Type::Coord);
+            return _coordValue;
+        }
+
+        void setCoord(const Coord& coord) noexcept
+        {
+            _coordValue = coord;
+            _type = Type::Coord;
+        }
+
+        uint8_t getUint8() const noexcept
+        {
+            EWM_ASSERT(_type == Type::UInt8);
+            return _uint8Value;
+        }
+
+        void setUint8(const uint8_t& octet) noexcept
+        {
+            _uint8Value = octet;
+            _type = Type::UInt8;
+        }
+
+        uint32_t getUint32() const noexcept
+        {
+            EWM_ASSERT(_type == Type::UInt32);
+            return _uint32Value;
+        }
+
+        void setUint32(const uint32_t& dword) noexcept
+        {
+            _uint32Value = dword;
+            _type = Type::UInt32;
+        }
+
+        float getFloat() const noexcept
+        {
+            EWM_ASSERT(_type == Type::Float);
+            return _floatValue;
+        }
+
+        void setFloat(const float& flt) noexcept
+        {
+            _floatValue = flt;
+            _type = Type::Float;
+        }
+
+    private:
+        union
+        {
+            Extent _extentValue;
+            Coord _coordValue;
+            uint8_t _uint8Value;
+            uint32_t _uint32Value;
+            float _floatValue = 0.0f;
+        };
+        Type _type = Type::Empty;
+    };
+
+    /**
+     * Drawing primitives recorded while a window drew itself. As long as nothing about
+     * the window changes, re-drawing it is a matter of replaying them, without the
+     * layout work (e.g. line breaking) that produced them, and skipping the ones that
+     * fall outside the clip. Coordinates are those of the graphics context.
+     */
+    class DisplayList
+    {
+    public:
+        enum class Op : uint8_t
+        {
+            FillRect,
+            FillRoundRect,
+            DrawRoundFrame,
+            DrawLine,
+            DrawChar
+        };
+
+        struct Command
+        {
+            Op op            = Op::FillRect;
+            uint8_t size     = 1; /**< DrawChar: text size. DrawRoundFrame: thickness. */
+            Color color      = 0;
+            Coord x          = 0; /**< DrawLine: x0. DrawChar: origin. */
+            Coord y          = 0; /**< DrawLine: y0. DrawChar: origin. */
+            Coord w          = 0; /**< DrawLine: x1. */
+            Coord h          = 0; /**< DrawLine: y1. */
+            Coord param      = 0; /**< Corner radius, or character. */
+        };
+
+# if defined(EWM_STATIC_POOLS)
+        using CommandList = StaticVector<Command, EWM_POOL_DISPLAY_LIST>;
+        static constexpr bool Enabled = EWM_POOL_DISPLAY_LIST > 0;
+# else
+        using CommandList = std::vector<Command>;
+        static constexpr bool Enabled = true;
+# endif
+
+        bool isValid() const noexcept { return _valid; }
+        void invalidate() noexcept { _valid = false; }
+
+        /** Returns the client rect of the window when it was recorded. */
+        Rect getRect() const noexcept { return _rect; }
+
+        /** Discards the commands, and starts recording a window with the given rect. */
+        void begin(const Rect& rect) noexcept
+        {
+            _commands.clear();
+            _rect     = rect;
+            _font     = nullptr;
+            _fontSet  = false;
+            _complete = true;
+            _valid    = false;
+        }
+
+        /** Stops recording; the list is only valid if everything was recorded. */
+        void end(bool drawn) noexcept { _valid = drawn && _complete; }
+
+        /** Records the font of the DrawChar commands that follow (only one per list). */
+        void setFont(const Font* font) noexcept
+        {
+            if (_fontSet && font != _font) {
+                _complete = false;
+            }
+            _font    = font;
+            _fontSet = true;
+        }
+
+        void push(const Command& command)
+        {
+# if defined(EWM_STATIC_POOLS)
+            if (!_commands.push_back(command)) {
+                _complete = false;
+            }
+# else
+            _commands.push_back(command);
+# endif
+        }
+
+        /** Draws the commands that intersect clip (all of them, if clip is empty). */
+        void replay(const GfxContextPtr& ctx, const Rect& clip) const
+        {
+            EWM_ASSERT(ctx);
+            if (_fontSet) {
+                ctx->setFont(_font);
+            }
+            for (const auto& cmd : _commands) {
+                Rect bounds = _getBounds(cmd);
+                if (!clip.empty()) {
+                    if (!(bounds.left < clip.right && clip.left < bounds.right &&
+                          bounds.top < clip.bottom && clip.top < bounds.bottom)) {
+                        continue;
+                    }
+                    bounds = Rect(max(bounds.left, clip.left), max(bounds.top, clip.top),
+                        min(bounds.right, clip.right), min(bounds.bottom, clip.bottom));
+                }
+                switch (cmd.op) {
+                    case Op::FillRect:
+                        ctx->fillRect(bounds.left, bounds.top, bounds.width(), bounds.height(),
+                            cmd.color);
+                        break;
+                    case Op::FillRoundRect:
+                        ctx->fillRoundRect(cmd.x, cmd.y, cmd.w, cmd.h, cmd.param, cmd.color);
+                        break;
+                    case Op::DrawRoundFrame:
+                        drawRoundFrame(ctx, cmd.x, cmd.y, cmd.w, cmd.h, cmd.param, cmd.size,
+                            cmd.color);
+                        break;
+                    case Op::DrawLine:
+                        ctx->drawLine(cmd.x, cmd.y, cmd.w, cmd.h, cmd.color);
+                        break;
+                    case Op::DrawChar:
+                        ctx->setTextSize(cmd.size);
+                        ctx->drawChar(cmd.x, cmd.y, static_cast<unsigned char>(cmd.param),
+                            cmd.color, cmd.color
+# if defined(EWM_GFX_ADAFRUIT) || defined(EWM_NATIVE_CANVAS)
+                            , cmd.size
+# endif
+                        );
+                        break;
+                }
+            }
+        }
+
+    private:
+        Rect _getBounds(const Command& cmd) const noexcept
+        {
+            switch (cmd.op) {
+                case Op::DrawLine:
+                    return Rect(min(cmd.x, cmd.w), min(cmd.y, cmd.h),
+                        max(cmd.x, cmd.w) + 1, max(cmd.y, cmd.h) + 1);
+                case Op::DrawChar: {
+                    uint8_t cx  = 0;
+                    uint8_t cy  = 0;
+                    int8_t xOff = 0;
+                    int8_t yOff = 0;
+                    getCharBounds(static_cast<uint8_t>(cmd.param), &cx, &cy, nullptr, nullptr,
+                        &xOff, &yOff, cmd.size, _font);
+                    const Coord left = cmd.x + (xOff * cmd.size);
+                    const Coord top  = cmd.y + (yOff * cmd.size);
+                    return Rect(left, top, left + cx, top + cy);
+                }
+                default:
+                    return Rect(cmd.x, cmd.y, cmd.x + cmd.w, cmd.y + cmd.h);
+            }
+        }
+
+        CommandList _commands;
+        Rect _rect;
+        const Font* _font = nullptr;
+        bool _fontSet     = false;
+        bool _complete    = true;
+        bool _valid       = false;
+    };
+
+    class ITheme
+    {
+    public:
+        enum class DisplaySize : uint8_t
+        {
+            Small = 0,
+            Medium,
+            Large
+        };
+
+        virtual void setDisplayExtents(Extent, Extent) = 0;
+
+        virtual Color getColor(ColorID) const = 0;
+        virtual Variant getMetric(MetricID) const = 0;
+
+        virtual void drawScreensaver(const GfxDisplayPtr&) const = 0;
+
+        virtual void setDefaultFont(const Font*) = 0;
+        virtual const Font* getDefaultFont() const = 0;
+
+        virtual DisplaySize getDisplaySize() const = 0;
+        virtual Extent getScaledValue(Extent) const = 0;
+
+        /**
+         * Limits the draw in progress to a rect (in context coordinates): pixels
+         * outside of it are already current, so the draw* functions may skip them. An
+         * empty rect removes the clip.
+         */
+        virtual void setClipRect(const Rect&) = 0;
+        virtual Rect getClipRect() const = 0;
+
+        /**
+         * While set, the draw* functions also record what they draw into the list.
+         * Returns false if the theme is unable to record.
+         */
+        virtual bool setRecorder(DisplayList*) = 0;
+
+        virtual void drawWindowFrame(const GfxContextPtr&, const Rect&, Coord, Color) const = 0;
+        virtual void drawWindowShadow(const GfxContextPtr&, const Rect&, Coord, Color) const = 0;
+        virtual void drawWindowBackground(const GfxContextPtr&, const Rect&, Coord, Color) const = 0;
+        virtual void drawText(const GfxContextPtr&, const char*, DrawText, const Rect&,
+            uint8_t, Color, const Font*) const = 0;
+
+        virtual void drawProgressBarBackground(const GfxContextPtr&, const Rect&) const = 0;
+        virtual void drawProgressBarProgress(const GfxContextPtr&, const Rect&, float) const = 0;
+        virtual void drawProgressBarIndeterminate(const GfxContextPtr&, const Rect&, float) const = 0;
+
+        virtual void drawCheckBox(const GfxContextPtr&, const char*, bool, const Rect&) const = 0;
+    };
+
+    using ThemePtr = std::shared_ptr<ITheme>;
+
+    class DefaultTheme : public ITheme
+    {
+    public:
+        DefaultTheme() = default;
+
+        void setDisplayExtents(Extent width, Extent height) final
+        {
+            _displayWidth  = width;
+            _displayHeight = height;
+            // Every glyph advances at least one pixel, so a line never holds more
+            // glyphs than this; reserving now keeps drawText() from allocating later.
+            _charXAdvs.reserve(static_cast<size_t>(width) + 1);
+        }
+
+        Color getColor(ColorID colorID) const final
+        {
+            switch (colorID) {
+                case ColorID::Screensaver:        return 0x0000;
+                case ColorID::PromptBg:           return 0xef5c;
+                case ColorID::PromptFrame:        return 0x9cf3;
+                case ColorID::PromptShadow:       return 0xb5b6;
                 case ColorID::WindowText:         return 0x0000;
                 case ColorID::WindowBg:           return 0xdedb;
                 case ColorID::WindowFrame:        return 0x9cf3;
@@ -1001,16 +3771,25 @@ namespace exostra
             }
         }
 
+        void setClipRect(const Rect& rect) final { _clip = rect; }
+        Rect getClipRect() const final { return _clip; }
+
+        bool setRecorder(DisplayList* recorder) final
+        {
+            _recorder = recorder;
+            return true;
+        }
+
         void drawWindowFrame(const GfxContextPtr& ctx, const Rect& rect,
             Coord radius, Color color) const final
         {
-            auto tmp = rect;
-            auto pixels = getMetric(MetricID::WindowFramePx).getExtent();
-            while (pixels-- > 0) {
-                EWM_ASSERT(ctx);
-                ctx->drawRoundRect(tmp.left, tmp.top, tmp.width(), tmp.height(), radius, color);
-                tmp.deflate(1);
+            const auto pixels = getMetric(MetricID::WindowFramePx).getExtent();
+            if (!_isInClip(rect) || _isClipWithin(rect, pixels + radius)) {
+                return;
             }
+            EWM_ASSERT(ctx);
+            _drawRoundFrame(ctx, rect.left, rect.top, rect.width(), rect.height(), radius,
+                pixels, color);
         }
 
         void drawWindowShadow(const GfxContextPtr& ctx, const Rect& rect,
@@ -1018,28 +3797,42 @@ namespace exostra
         {
             const auto thickness = getMetric(MetricID::WindowFramePx).getExtent();
             EWM_ASSERT(ctx);
-            ctx->drawLine(
-                rect.left + radius + thickness,
-                rect.bottom,
-                rect.left + (rect.width() - (radius + (thickness * 2))),
-                rect.bottom,
-                color
-            );
-            ctx->drawLine(
-                rect.right,
-                rect.top + radius + thickness,
-                rect.right,
-                rect.top + (rect.height() - (radius + (thickness * 2))),
-                color
-            );
+            if (_isInClip(Rect(rect.left, rect.bottom, rect.right, rect.bottom + 1))) {
+                _drawLine(
+                    ctx,
+                    rect.left + radius + thickness,
+                    rect.bottom,
+                    rect.left + (rect.width() - (radius + (thickness * 2))),
+                    rect.bottom,
+                    color
+                );
+            }
+            if (_isInClip(Rect(rect.right, rect.top, rect.right + 1, rect.bottom))) {
+                _drawLine(
+                    ctx,
+                    rect.right,
+                    rect.top + radius + thickness,
+                    rect.right,
+                    rect.top + (rect.height() - (radius + (thickness * 2))),
+                    color
+                );
+            }
         }
 
         void drawWindowBackground(const GfxContextPtr& ctx, const Rect& rect,
             Coord radius, Color color) const final
         {
             EWM_ASSERT(ctx);
-            ctx->fillRoundRect(rect.left, rect.top, rect.width(), rect.height(),
-                radius, color);
+            if (radius == 0) {
+                const auto clipped = _getClipped(rect);
+                if (!clipped.empty()) {
+                    _fillRect(ctx, clipped.left, clipped.top, clipped.width(), clipped.height(),
+                        color);
+                }
+            } else if (_isInClip(rect)) {
+                _fillRoundRect(ctx, rect.left, rect.top, rect.width(), rect.height(),
+                    radius, color);
+            }
         }
 
         void drawText(const GfxContextPtr& ctx, const char* text, DrawText flags,
@@ -1048,6 +3841,9 @@ namespace exostra
             EWM_ASSERT(ctx);
             ctx->setTextSize(textSize);
             ctx->setFont(font);
+            if (_recorder != nullptr) {
+                _recorder->setFont(font);
+            }
 
             const bool xCenter = bitsHigh(flags, DrawText::Center);
             const bool singleLine = bitsHigh(flags, DrawText::Single);
@@ -1079,7 +3875,8 @@ namespace exostra
             while (*cursor != '\0') {
                 xAccum = rect.left + xPadding;
                 const char* old_cursor = cursor;
-                std::deque<uint8_t> charXAdvs;
+                auto& charXAdvs = _charXAdvs;
+                charXAdvs.clear();
                 bool clipped = false;
                 while (xAccum <= xExtent && *cursor != '\0') {
                     /// TODO: handle \n and \r
@@ -1126,16 +3923,10 @@ namespace exostra
                     ? rect.left + (rect.width() / 2) - (drawnWidth / 2)
                     : rect.left + xPadding;
                 while (old_cursor < cursor) {
-                    ctx->drawChar(
-                        xAccum,
-                        yAccum,
-                        *old_cursor++,
-                        textColor,
-                        textColor
-# if defined(EWM_GFX_ADAFRUIT)
-                        , textSize
-# endif
-                    );
+                    if (_isGlyphInClip(*old_cursor, xAccum, yAccum, textSize, font)) {
+                        _drawChar(ctx, xAccum, yAccum, *old_cursor, textColor, textSize);
+                    }
+                    old_cursor++;
                     xAccum += charXAdvs[
                         charXAdvs.size() - 2 - ((cursor + rewound) - old_cursor - 1)
                     ];
@@ -1148,16 +3939,9 @@ namespace exostra
                         getCharBounds('.', nullptr, nullptr, &xAdv, &yAdv,
                             &xOff, &yOff, textSize, font);
                         for (uint8_t ellipsis = 0; ellipsis < 3; ellipsis++) {
-                            ctx->drawChar(
-                                xAccum,
-                                yAccum,
-                                '.',
-                                textColor,
-                                textColor
-# if defined(EWM_GFX_ADAFRUIT)
-                                , textSize
-# endif
-                            );
+                            if (_isGlyphInClip('.', xAccum, yAccum, textSize, font)) {
+                                _drawChar(ctx, xAccum, yAccum, '.', textColor, textSize);
+                            }
                             xAccum += xAdv;
                         }
                     }
@@ -1169,8 +3953,11 @@ namespace exostra
         void drawProgressBarBackground(const GfxContextPtr& ctx, const Rect& rect) const final
         {
             EWM_ASSERT(ctx);
-            ctx->fillRect(rect.left, rect.top, rect.width(), rect.height(),
-                getColor(ColorID::ProgressBg));
+            const auto clipped = _getClipped(rect);
+            if (!clipped.empty()) {
+                _fillRect(ctx, clipped.left, clipped.top, clipped.width(), clipped.height(),
+                    getColor(ColorID::ProgressBg));
+            }
         }
 
         void drawProgressBarProgress(const GfxContextPtr& ctx, const Rect& rect, float percent) const final
@@ -1179,9 +3966,12 @@ namespace exostra
             auto barRect = rect;
             barRect.deflate(getMetric(MetricID::WindowFramePx).getExtent() * 2);
             barRect.right = barRect.left + abs(barRect.width() * (min(100.0f, percent) / 100.0f));
+            barRect = _getClipped(barRect);
             EWM_ASSERT(ctx);
-            ctx->fillRect(barRect.left, barRect.top, barRect.width(),
-                barRect.height(), getColor(ColorID::ProgressFill));
+            if (!barRect.empty()) {
+                _fillRect(ctx, barRect.left, barRect.top, barRect.width(),
+                    barRect.height(), getColor(ColorID::ProgressFill));
+            }
         }
 
         void drawProgressBarIndeterminate(const GfxContextPtr& ctx, const Rect& rect, float counter) const final
@@ -1216,7 +4006,7 @@ namespace exostra
                 );
             }
             EWM_ASSERT(ctx);
-            ctx->fillRect(x, barRect.top, width, barRect.height(),
+            _fillRect(ctx, x, barRect.top, width, barRect.height(),
                 getColor(ColorID::ProgressFill));
         }
 
@@ -1232,19 +4022,13 @@ namespace exostra
             );
             checkableRect.top = rect.top + ((rect.height() / 2) - (checkableRect.height() / 2));
             EWM_ASSERT(ctx);
-            ctx->fillRoundRect(
-                checkableRect.left,
-                checkableRect.top,
-                checkableRect.width(),
-                checkableRect.height(),
-                radius,
-                getColor(ColorID::CheckBoxCheckBg)
-            );
+            drawWindowBackground(ctx, checkableRect, radius, getColor(ColorID::CheckBoxCheckBg));
             drawWindowFrame(ctx, checkableRect, radius, getColor(ColorID::CheckBoxCheckFrame));
-            if (checked) {
+            if (checked && _isInClip(checkableRect)) {
                 auto rectCheckMark = checkableRect;
                 rectCheckMark.deflate(getMetric(MetricID::CheckBoxCheckMarkPadding).getExtent());
-                ctx->fillRoundRect(
+                _fillRoundRect(
+                    ctx,
                     rectCheckMark.left,
                     rectCheckMark.top,
                     rectCheckMark.width(),
@@ -1271,9 +4055,115 @@ namespace exostra
         }
 
     private:
+        void _fillRect(const GfxContextPtr& ctx, Coord x, Coord y, Coord w, Coord h,
+            Color color) const
+        {
+            _record(DisplayList::Op::FillRect, x, y, w, h, 0, color);
+            ctx->fillRect(x, y, w, h, color);
+        }
+
+        void _fillRoundRect(const GfxContextPtr& ctx, Coord x, Coord y, Coord w, Coord h,
+            Coord radius, Color color) const
+        {
+            _record(DisplayList::Op::FillRoundRect, x, y, w, h, radius, color);
+            ctx->fillRoundRect(x, y, w, h, radius, color);
+        }
+
+        void _drawRoundFrame(const GfxContextPtr& ctx, Coord x, Coord y, Coord w, Coord h,
+            Coord radius, Coord thickness, Color color) const
+        {
+            _record(DisplayList::Op::DrawRoundFrame, x, y, w, h, radius, color,
+                static_cast<uint8_t>(thickness));
+            drawRoundFrame(ctx, x, y, w, h, radius, thickness, color);
+        }
+
+        void _drawLine(const GfxContextPtr& ctx, Coord x0, Coord y0, Coord x1, Coord y1,
+            Color color) const
+        {
+            _record(DisplayList::Op::DrawLine, x0, y0, x1, y1, 0, color);
+            ctx->drawLine(x0, y0, x1, y1, color);
+        }
+
+        void _drawChar(const GfxContextPtr& ctx, Coord x, Coord y, char ch, Color color,
+            uint8_t textSize) const
+        {
+            _record(DisplayList::Op::DrawChar, x, y, 0, 0, static_cast<uint8_t>(ch), color,
+                textSize);
+            ctx->drawChar(x, y, ch, color, color
+# if defined(EWM_GFX_ADAFRUIT) || defined(EWM_NATIVE_CANVAS)
+                , textSize
+# endif
+            );
+        }
+
+        void _record(DisplayList::Op op, Coord x, Coord y, Coord w, Coord h, Coord param,
+            Color color, uint8_t size = 1) const
+        {
+            if (_recorder != nullptr) {
+                DisplayList::Command cmd;
+                cmd.op       = op;
+                cmd.size     = size;
+                cmd.color    = color;
+                cmd.x        = x;
+                cmd.y        = y;
+                cmd.w        = w;
+                cmd.h        = h;
+                cmd.param    = param;
+                _recorder->push(cmd);
+            }
+        }
+
+        /** Returns true if any of rect is within the clip. */
+        bool _isInClip(const Rect& rect) const noexcept
+        {
+            return _clip.empty() || (rect.left < _clip.right && _clip.left < rect.right &&
+                rect.top < _clip.bottom && _clip.top < rect.bottom);
+        }
+
+        /** Returns true if the clip lies within rect, inset by the given margin. */
+        bool _isClipWithin(const Rect& rect, Coord margin) const noexcept
+        {
+            return !_clip.empty() && _clip.left >= rect.left + margin &&
+                _clip.top >= rect.top + margin && _clip.right <= rect.right - margin &&
+                _clip.bottom <= rect.bottom - margin;
+        }
+
+        Rect _getClipped(const Rect& rect) const noexcept
+        {
+            if (_clip.empty()) {
+                return rect;
+            }
+            if (!_isInClip(rect)) {
+                return Rect();
+            }
+            return Rect(max(rect.left, _clip.left), max(rect.top, _clip.top),
+                min(rect.right, _clip.right), min(rect.bottom, _clip.bottom));
+        }
+
+        /** Returns true if any of a glyph drawn with its origin at x, y is within the clip. */
+        bool _isGlyphInClip(char ch, Coord x, Coord y, uint8_t textSize,
+            const Font* font) const noexcept
+        {
+            if (_clip.empty()) {
+                return true;
+            }
+            uint8_t cx  = 0;
+            uint8_t cy  = 0;
+            int8_t xOff = 0;
+            int8_t yOff = 0;
+            getCharBounds(ch, &cx, &cy, nullptr, nullptr, &xOff, &yOff, textSize, font);
+            const Coord left = x + (xOff * textSize);
+            const Coord top  = y + (yOff * textSize);
+            return _isInClip(Rect(left, top, left + cx, top + cy));
+        }
+
         Extent _displayWidth     = 0;
         Extent _displayHeight    = 0;
         const Font* _defaultFont = nullptr;
+        Rect _clip;
+        DisplayList* _recorder   = nullptr;
+        /** drawText() scratch; reused so that drawing doesn't allocate once warm. */
+        mutable std::vector<uint8_t> _charXAdvs;
     };
 
     struct PackagedMessage
@@ -1283,9 +4173,14 @@ namespace exostra
         MsgParam p2 = 0;
     };
 
+# if defined(EWM_STATIC_POOLS)
+    using PackagedMessageQueue = StaticQueue<PackagedMessage, EWM_POOL_MESSAGES>;
+# else
     using PackagedMessageQueue = std::queue<PackagedMessage>;
+# endif
 
     class IWindow;
+    class WindowContainer;
     class IWindowContainer
     {
     public:
@@ -1304,7 +4199,8 @@ namespace exostra
     class IWindow : public IWindowContainer
     {
     public:
-        virtual std::shared_ptr<IWindow> getParent() const = 0;
+        virtual IWindow* getParent() const noexcept = 0;
+        virtual WindowContainer& getChildren() noexcept = 0;
 
         virtual GfxContextPtr getGfxContext() const = 0;
 
@@ -1314,21 +4210,27 @@ namespace exostra
         virtual Rect getClientRect() const noexcept = 0;
 
         virtual Rect getDirtyRect() const noexcept = 0;
+        virtual const DirtyRegion& getDirtyRegion() const noexcept = 0;
         virtual void markRectDirty(const Rect&) noexcept = 0;
+        virtual void markRectExposed(const Rect&) noexcept = 0;
 
         virtual Style getStyle() const noexcept = 0;
         virtual void setStyle(Style) noexcept = 0;
 
         virtual WindowID getID() const noexcept = 0;
 
+        virtual WindowHandle getHandle() const noexcept = 0;
+        virtual void setHandle(WindowHandle) noexcept = 0;
+
         virtual uint8_t getZOrder() const noexcept = 0;
         virtual void setZOrder(uint8_t) noexcept = 0;
 
         virtual State getState() const noexcept = 0;
         virtual void setState(State) noexcept = 0;
 
-        virtual std::string getText() const = 0;
-        virtual void setText(const std::string&) = 0;
+        virtual const char* getText() const noexcept = 0;
+        virtual void setText(std::string_view) = 0;
+        virtual void setStaticText(const char*) = 0;
 
         virtual Color getBgColor() const noexcept = 0;
         virtual void setBgColor(Color) noexcept = 0;
@@ -1357,6 +4259,7 @@ namespace exostra
         virtual bool isDirty() const noexcept = 0;
         virtual void setDirty(bool) noexcept = 0;
         virtual bool isDrawable() const noexcept = 0;
+        virtual bool isOpaque() const noexcept = 0;
 
         virtual bool destroy() = 0;
 
@@ -1380,7 +4283,11 @@ namespace exostra
     class WindowContainer : public IWindowContainer
     {
     public:
+# if defined(EWM_STATIC_POOLS)
+        using WindowDeque = StaticVector<WindowPtr, EWM_POOL_CHILDREN>;
+# else
         using WindowDeque = std::deque<WindowPtr>;
+# endif
 
         WindowContainer() = default;
         virtual ~WindowContainer() = default;
@@ -1456,6 +4363,12 @@ namespace exostra
             if (getChildByID(child->getID()) != nullptr) {
                 return false;
             }
+# if defined(EWM_STATIC_POOLS)
+            if (_children.full()) {
+                EWM_LOG_E("too many children (max: %zu)", _children.capacity());
+                return false;
+            }
+# endif
             uint8_t zOrder = 0;
             if (auto last = _children.rbegin(); last != _children.rend()) {
                 zOrder = (*last)->getZOrder() + 1;
@@ -1490,39 +4403,370 @@ namespace exostra
 
         void forEachChild(const std::function<bool(const WindowPtr&)>& cb) override
         {
-            if (!cb) {
-                return;
+            if (cb) {
+                forEach(cb);
+            }
+        }
+
+        void forEachChildReverse(const std::function<bool(const WindowPtr&)>& cb) override
+        {
+            if (cb) {
+                forEachReverse(cb);
             }
+        }
+
+        /**
+         * Calls cb(const WindowPtr&) for each child, from the bottom of the z-order to
+         * the top, until it returns false. Unlike forEachChild(), the callback can be
+         * inlined, and the children are passed by reference rather than copied.
+         */
+        template<typename TCallback>
+        void forEach(TCallback&& cb)
+        {
 # if !defined(EWM_NOMUTEXES)
             ScopeLock lock(_childMtx);
 # endif
-            for (auto child : _children) {
+            for (const auto& child : _children) {
                 if (!cb(child)) {
                     break;
                 }
             }
         }
 
-        void forEachChildReverse(const std::function<bool(const WindowPtr&)>& cb) override
+        /** Like forEach(), but from the top of the z-order to the bottom. */
+        template<typename TCallback>
+        void forEachReverse(TCallback&& cb)
+        {
+# if !defined(EWM_NOMUTEXES)
+            ScopeLock lock(_childMtx);
+# endif
+            for (auto it = _children.rbegin(); it != _children.rend(); it++) {
+                if (!cb(*it)) {
+                    break;
+                }
+            }
+        }
+
+    private:
+        WindowDeque _children;
+# if !defined(EWM_NOMUTEXES)
+        Mutex _childMtx;
+# endif
+    };
+
+    /**
+     * Maps window handles to windows in O(1). Freed slots are queued, and only reused
+     * once every other slot has been, so that reuse (and thus the wrap-around of the
+     * generation counts) is spread evenly over the whole table.
+     */
+    class HandleTable
+    {
+    public:
+        static_assert(EWM_HANDLE_INDEX_BITS > 0 && EWM_HANDLE_INDEX_BITS < 16);
+
+        EWM_CONST(uint8_t, IndexBits, EWM_HANDLE_INDEX_BITS);
+        EWM_CONST(WindowHandle, IndexMask, (1U << IndexBits) - 1U);
+        EWM_CONST(WindowHandle, MaxGeneration, (1U << (16U - IndexBits)) - 1U);
+        /** Slot 0 is never used, so that WH_INVALID never refers to a window. */
+# if defined(EWM_STATIC_POOLS)
+        EWM_CONST(size_t, Capacity, min(size_t(IndexMask), size_t(EWM_POOL_WINDOWS)));
+# else
+        EWM_CONST(size_t, Capacity, IndexMask);
+# endif
+
+        /** Returns a handle for the window, or WH_INVALID if the table is full. */
+        WindowHandle add(const WindowPtr& win)
+        {
+            EWM_ASSERT(win);
+# if !defined(EWM_NOMUTEXES)
+            ScopeLock lock(_mtx);
+# endif
+            WindowHandle index = 0;
+            if (_slots.size() <= Capacity) {
+                if (_slots.empty()) {
+                    _slots.push_back(Slot());
+                }
+                index = static_cast<WindowHandle>(_slots.size());
+                _slots.push_back(Slot());
+            } else if (_freeHead != 0) {
+                index     = _freeHead;
+                _freeHead = _slots[index].nextFree;
+                if (_freeHead == 0) {
+                    _freeTail = 0;
+                }
+            } else {
+                return WH_INVALID;
+            }
+            auto& slot    = _slots[index];
+            slot.window   = win;
+            slot.nextFree = 0;
+            _count++;
+            return _makeHandle(index, slot.generation);
+        }
+
+        /** Invalidates the handle. Returns false if it was already invalid. */
+        bool remove(WindowHandle handle)
+        {
+# if !defined(EWM_NOMUTEXES)
+            ScopeLock lock(_mtx);
+# endif
+            auto slot = _getSlot(handle);
+            if (slot == nullptr) {
+                return false;
+            }
+            slot->window.reset();
+            slot->generation = slot->generation == MaxGeneration ? 1U : slot->generation + 1U;
+            slot->nextFree   = 0;
+            const WindowHandle index = handle & IndexMask;
+            if (_freeTail != 0) {
+                _slots[_freeTail].nextFree = index;
+            } else {
+                _freeHead = index;
+            }
+            _freeTail = index;
+            _count--;
+            return true;
+        }
+
+        /** Returns the window that the handle refers to, or nullptr if it is stale. */
+        WindowPtr get(WindowHandle handle) const
+        {
+# if !defined(EWM_NOMUTEXES)
+            ScopeLock lock(_mtx);
+# endif
+            auto slot = _getSlot(handle);
+            return slot != nullptr ? slot->window.lock() : nullptr;
+        }
+
+        bool isValid(WindowHandle handle) const
+        {
+            return get(handle) != nullptr;
+        }
+
+        size_t size() const noexcept { return _count; }
+
+    private:
+        struct Slot
+        {
+            std::weak_ptr<IWindow> window;
+            WindowHandle generation = 1U;
+            WindowHandle nextFree   = 0U;
+        };
+
+        static WindowHandle _makeHandle(WindowHandle index, WindowHandle generation) noexcept
+        {
+            return static_cast<WindowHandle>((generation << IndexBits) | index);
+        }
+
+        const Slot* _getSlot(WindowHandle handle) const noexcept
+        {
+            const WindowHandle index = handle & IndexMask;
+            if (index == 0 || index >= _slots.size()) {
+                return nullptr;
+            }
+            const auto& slot = _slots[index];
+            if (slot.window.expired() || _makeHandle(index, slot.generation) != handle) {
+                return nullptr;
+            }
+            return &slot;
+        }
+
+        Slot* _getSlot(WindowHandle handle) noexcept
+        {
+            return const_cast<Slot*>(static_cast<const HandleTable*>(this)->_getSlot(handle));
+        }
+
+# if defined(EWM_STATIC_POOLS)
+        StaticVector<Slot, Capacity + 1> _slots;
+# else
+        std::vector<Slot> _slots;
+# endif
+        WindowHandle _freeHead = 0U;
+        WindowHandle _freeTail = 0U;
+        size_t _count          = 0U;
+# if !defined(EWM_NOMUTEXES)
+        mutable Mutex _mtx;
+# endif
+    };
+
+    /** A rect of pixels to be copied from an off-screen buffer to the display. */
+    struct FlushJob
+    {
+        GfxContextPtr ctx;  /**< Source buffer (kept alive until transferred). */
+        Rect src;           /**< Source rect, in buffer coordinates. */
+        Point dst;          /**< Top left of the destination, in display coordinates. */
+        uint32_t frame = 0; /**< Frame during which the job was queued. */
+    };
+
+    /**
+     * Queue of rects waiting to be transferred to the display. With EWM_ASYNC_FLUSH,
+     * a worker thread drains the queue while the next frame is composed; up to two
+     * frames may be outstanding (one transferring, one being queued), and callers
+     * must use waitForRect() before drawing into a buffer that may still be in
+     * flight. Otherwise, jobs are transferred synchronously as they are pushed.
+     */
+    class FlushQueue
+    {
+    public:
+        using Transfer = std::function<void(const FlushJob&)>;
+
+        EWM_CONST(size_t, Depth, EWM_FLUSH_QUEUE_DEPTH);
+        EWM_CONST(uint32_t, MaxFramesInFlight, 2U);
+
+        FlushQueue() = delete;
+
+        explicit FlushQueue(const Transfer& transfer) : _transfer(transfer)
+        {
+            EWM_ASSERT(_transfer);
+        }
+
+        FlushQueue(const FlushQueue&) = delete;
+        FlushQueue& operator=(const FlushQueue&) = delete;
+
+        ~FlushQueue()
+        {
+            stop();
+        }
+
+        /** Starts the worker thread (if any). */
+        void start()
+        {
+# if defined(EWM_ASYNC_FLUSH)
+            std::unique_lock<std::mutex> lock(_mtx);
+            if (!_worker.joinable()) {
+                _stopping = false;
+                _worker = std::thread([this]() { _run(); });
+            }
+# endif
+        }
+
+        /** Transfers everything that is queued, then stops the worker thread (if any). */
+        void stop()
+        {
+# if defined(EWM_ASYNC_FLUSH)
+            {
+                std::unique_lock<std::mutex> lock(_mtx);
+                if (!_worker.joinable()) {
+                    return;
+                }
+                _stopping = true;
+            }
+            _cv.notify_all();
+            _worker.join();
+# endif
+        }
+
+        void push(FlushJob&& job)
+        {
+# if defined(EWM_ASYNC_FLUSH)
+            std::unique_lock<std::mutex> lock(_mtx);
+            if (_worker.joinable()) {
+                _cv.wait(lock, [this]() { return _count < Depth; });
+                job.frame = _frame;
+                _jobs[(_head + _count) % Depth] = std::move(job);
+                _count++;
+                lock.unlock();
+                _cv.notify_all();
+                return;
+            }
+            lock.unlock();
+# endif
+            job.frame = _frame;
+            _transfer(job);
+        }
+
+        /**
+         * Ends the frame whose jobs have been pushed so far. Blocks until no more
+         * than one earlier frame is still being transferred.
+         */
+        void endFrame()
+        {
+# if defined(EWM_ASYNC_FLUSH)
+            std::unique_lock<std::mutex> lock(_mtx);
+            _frame++;
+            _cv.wait(lock, [this]() { return _framesInFlight() < MaxFramesInFlight; });
+# else
+            _frame++;
+# endif
+        }
+
+        /** Blocks until every queued job has been transferred. */
+        void waitIdle()
+        {
+# if defined(EWM_ASYNC_FLUSH)
+            std::unique_lock<std::mutex> lock(_mtx);
+            _cv.wait(lock, [this]() { return _count == 0 && !_transferring; });
+# endif
+        }
+
+        /**
+         * Blocks until no queued or in-flight job reads from the given rect (in buffer
+         * coordinates) of ctx, so that it may safely be drawn into.
+         */
+        void waitForRect([[maybe_unused]] const GfxContext* ctx,
+            [[maybe_unused]] const Rect& rect)
+        {
+# if defined(EWM_ASYNC_FLUSH)
+            std::unique_lock<std::mutex> lock(_mtx);
+            _cv.wait(lock, [&]() { return !_isReading(ctx, rect); });
+# endif
+        }
+
+        uint32_t getFrame() const noexcept { return _frame; }
+
+    private:
+# if defined(EWM_ASYNC_FLUSH)
+        void _run()
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            while (true) {
+                _cv.wait(lock, [this]() { return _count > 0 || _stopping; });
+                if (_count == 0) {
+                    break;
+                }
+                // The job stays at the head of the queue while it is transferred, so
+                // that waitForRect() sees it as in flight.
+                _transferring = true;
+                lock.unlock();
+                _transfer(_jobs[_head]);
+                lock.lock();
+                _jobs[_head] = FlushJob();
+                _head = (_head + 1) % Depth;
+                _count--;
+                _transferring = false;
+                _cv.notify_all();
+            }
+        }
+
+        uint32_t _framesInFlight() const noexcept
+        {
+            return _count > 0 ? _frame - _jobs[_head].frame : 0U;
+        }
+
+        bool _isReading(const GfxContext* ctx, const Rect& rect) const noexcept
         {
-            if (!cb) {
-                return;
-            }
-# if !defined(EWM_NOMUTEXES)
-            ScopeLock lock(_childMtx);
-# endif
-            for (auto it = _children.rbegin(); it != _children.rend(); it++) {
-                if (!cb((*it))) {
-                    break;
+            for (size_t idx = 0; idx < _count; idx++) {
+                const auto& job = _jobs[(_head + idx) % Depth];
+                if (job.ctx.get() == ctx &&
+                    job.src.left < rect.right && rect.left < job.src.right &&
+                    job.src.top < rect.bottom && rect.top < job.src.bottom) {
+                    return true;
                 }
             }
+            return false;
         }
 
-    private:
-        WindowDeque _children;
-# if !defined(EWM_NOMUTEXES)
-        Mutex _childMtx;
+        std::array<FlushJob, Depth> _jobs;
+        size_t _head        = 0;
+        size_t _count       = 0;
+        bool _transferring  = false;
+        bool _stopping      = false;
+        std::mutex _mtx;
+        std::condition_variable _cv;
+        std::thread _worker;
 # endif
+        Transfer _transfer;
+        uint32_t _frame = 0U;
     };
 
     enum class WMState : uint8_t
@@ -1533,12 +4777,41 @@ namespace exostra
         SSaverDrawn   = 1 << 2
     };
 
+    /** Where windows are drawn, and how the result reaches the display. */
+    enum class RenderMode : uint8_t
+    {
+        /** Each top-level window owns an off-screen buffer that retains its contents;
+         * damaged rects are copied from those buffers to the display. */
+        Retained = 0,
+        /** Windows have no buffers of their own. Damaged rects are re-drawn straight
+         * into the display's own framebuffer (e.g. Arduino_RGB_Display, or fbdev at
+         * 16bpp), optionally into a back page that is then flipped to the front. */
+        Panel,
+        /** Windows have no buffers of their own. Damaged rects are re-drawn into a
+         * single display-sized buffer, then copied from there to the display. Memory
+         * use is fixed, regardless of the number of windows. */
+        Shared,
+        /** Like Shared, but the damage is re-drawn one horizontal band at a time into a
+         * display-wide strip buffer (Config::bandHeight lines tall), which is flushed
+         * before moving on to the next band. */
+        Banded,
+        /** No buffers at all: damaged rects are re-drawn straight to the display,
+         * clipped to what is visible of each window. Some flicker is to be expected. */
+        Direct
+    };
+
     class WindowManager : public std::enable_shared_from_this<WindowManager>
     {
     public:
         struct Config
         {
             uint32_t minHitTestIntervalMsec = 0U;
+            RenderMode renderMode           = RenderMode::Retained;
+            bool pageFlip                   = false; /**< RenderMode::Panel only. */
+            Extent bandHeight               = EWM_BAND_HEIGHT; /**< RenderMode::Banded only. */
+            bool tileHash                   = false; /**< Skip unchanged tiles when flushing. */
+            bool calibrateFlush             = false; /**< Measure flushCost in begin(). */
+            FlushCost flushCost;
         };
 
         static constexpr uint32_t DefaultMinHitTestIntervalMsec = 200U;
@@ -1550,10 +4823,10 @@ namespace exostra
             const ThemePtr& theme,
             const Font* defaultFont,
             const Config* config = nullptr
-        ) : _registry(std::make_shared<WindowContainer>()),
-            _gfxDisplay(gfxDisplay), _theme(theme)
+        ) : _gfxDisplay(gfxDisplay),
+            _flushQueue([this](const FlushJob& job) { _flushJob(job); }),
+            _theme(theme)
         {
-            EWM_ASSERT(_registry);
             EWM_ASSERT(_gfxDisplay);
             EWM_ASSERT(_theme);
             _theme->setDefaultFont(defaultFont);
@@ -1566,6 +4839,7 @@ namespace exostra
 
         virtual ~WindowManager()
         {
+            _flushQueue.stop();
             tearDown();
         }
 
@@ -1593,15 +4867,16 @@ namespace exostra
 
         virtual void tearDown()
         {
-            _registry->forEachChild([](const WindowPtr& child)
+            _registry.forEach([](const WindowPtr& child)
             {
                 child->destroy();
                 return true;
             });
-            _registry->removeAllChildren();
+            _registry.removeAllChildren();
+            invalidateVisibleRegions();
         }
 
-        ThemePtr getTheme() const { return _theme; }
+        const ThemePtr& getTheme() const noexcept { return _theme; }
 
         Extent getDisplayWidth() const noexcept { return _gfxDisplay->width(); }
         Extent getDisplayHeight() const noexcept { return _gfxDisplay->height(); }
@@ -1620,12 +4895,12 @@ namespace exostra
             Coord y,
             Extent width,
             Extent height,
-            const std::string& text = std::string(),
+            std::string_view text = std::string_view(),
             const std::function<bool(const std::shared_ptr<TWindow>&)>& preCreateHook = nullptr
         )
         {
             if (id == WID_INVALID) {
-                EWM_LOG_E("%hhu is a reserved window ID", WID_INVALID);
+                EWM_LOG_E("%hu is a reserved window ID", WID_INVALID);
                 return nullptr;
             }
             if (bitsHigh(style, Style::FullScreen)) {
@@ -1647,18 +4922,17 @@ namespace exostra
                 &status
             );
             EWM_ASSERT(clsName != nullptr && status == 0);
-            std::shared_ptr<TWindow> win(
-                std::make_shared<TWindow>(
-                    shared_from_this(), parent, id, style, rect, text, clsName
-                )
-            );
+            auto win = _newWindow<TWindow>(shared_from_this(), parent, id, style, rect, text,
+                clsName);
             demangleBuf.fill('\0');
 # else
-            std::shared_ptr<TWindow> win(
-                std::make_shared<TWindow>(
-                    shared_from_this(), parent, id, style, rect, text
-                )
-            );
+            auto win = _newWindow<TWindow>(shared_from_this(), parent, id, style, rect, text);
+# endif
+# if defined(EWM_STATIC_POOLS)
+            if (!win) {
+                EWM_LOG_E("window pool exhausted (max: %zu)", WindowPool::Count);
+                return nullptr;
+            }
 # endif
             if (bitsHigh(style, Style::Child) && !parent) {
                 EWM_LOG_E("%s: Style::Child && null parent", win->toString().c_str());
@@ -1672,16 +4946,27 @@ namespace exostra
                 EWM_LOG_E("%s: pre-create hook failed", win->toString().c_str());
                 return nullptr;
             }
+            win->setHandle(_handles.add(win));
+            if (win->getHandle() == WH_INVALID) {
+                EWM_LOG_E("%s: no free window handles (max: %zu)", win->toString().c_str(),
+                    HandleTable::Capacity);
+                return nullptr;
+            }
             if (!win->routeMessage(Message::Create)) {
                 EWM_LOG_E("%s: Message::Create = false", win->toString().c_str());
+                _handles.remove(win->getHandle());
                 return nullptr;
             }
-            bool dupe = parent ? !parent->addChild(win) : !_registry->addChild(win);
+            bool dupe = parent ? !parent->addChild(win) : !_registry.addChild(win);
             if (dupe) {
-                EWM_LOG_E("duplicate window ID %hhu (parent: %hhu)",
+                EWM_LOG_E("duplicate window ID %hu (parent: %hu)",
                     id, parent ? parent->getID() : WID_INVALID);
+                _handles.remove(win->getHandle());
                 return nullptr;
             }
+            if (!parent) {
+                invalidateVisibleRegions();
+            }
             if (bitsHigh(win->getStyle(), Style::AutoSize)) {
                 win->routeMessage(Message::Resize);
             }
@@ -1695,7 +4980,7 @@ namespace exostra
             const WindowPtr& parent,
             WindowID id,
             Style style,
-            const std::string& text,
+            std::string_view text,
             const std::deque<typename TPrompt::ButtonInfo>& buttons,
             const typename TPrompt::ResultCallback& callback
         )
@@ -1754,365 +5039,1133 @@ namespace exostra
             if (pbar) {
                 pbar->setProgressBarStyle(pbarStyle);
             }
-            return pbar;
+            return pbar;
+        }
+
+        bool setForegroundWindow(const WindowPtr& win)
+        {
+            const bool success = _registry.setForegroundWindow(win);
+            if (success) {
+                invalidateVisibleRegions();
+            }
+            return success;
+        }
+
+        void hitTest(Coord x, Coord y)
+        {
+            if (millis() - _lastHitTestTime < _config.minHitTestIntervalMsec) {
+                return;
+            }
+            EWM_ASSERT(x >= 0 && y >= 0);
+            EWM_ASSERT(x <= getDisplayWidth() && y <= getDisplayHeight());
+            EWM_LOG_D("hit test at %hd,%hd", x, y);
+            if (bitsHigh(getState(), WMState::SSaverEnabled)) {
+                _ssLastActivity = millis();
+                if (bitsHigh(getState(), WMState::SSaverActive)) {
+                    return;
+                }
+            }
+            [[maybe_unused]] bool claimed = false;
+            _registry.forEachReverse([&](const WindowPtr& child)
+            {
+                if (!child->isDrawable()) {
+                    return true;
+                }
+                EWM_LOG_V("interrogating %s re: hit test at %hd,%hd",
+                    child->toString().c_str(), x, y);
+                InputParams params;
+                params.type = InputType::Tap;
+                params.x    = x;
+                params.y    = y;
+                if (child->processInput(&params)) {
+                    EWM_LOG_V("%s claimed hit test at %hd,%hd",
+                        params.handledBy.c_str(), x, y);
+                    claimed = true;
+                    return false;
+                }
+                return true;
+            });
+            if (!claimed) {
+                EWM_LOG_V("hit test at %hd,%hd unclaimed", x, y);
+            }
+            _lastHitTestTime = millis();
+        }
+
+        /**
+         * Marks the cached visible regions of the top-level windows as stale. Must be
+         * called whenever the z-order, visibility, or geometry of a top-level window
+         * changes; the regions are recomputed on the next render().
+         */
+        void invalidateVisibleRegions() noexcept
+        {
+            _visibleRegionsStale = true;
+        }
+
+        /** Returns the portion of a top-level window that is not obscured. */
+        Region getVisibleRegion(const IWindow* win)
+        {
+            if (_visibleRegionsStale) {
+                _updateVisibleRegions();
+            }
+            for (const auto& visible : _visibleRegions) {
+                if (visible.window == win) {
+                    return visible.region;
+                }
+            }
+            return Region();
+        }
+
+        Region getVisibleRegion(const WindowPtr& win)
+        {
+            return getVisibleRegion(win.get());
+        }
+
+        /**
+         * Returns true if no part of a top-level window can be seen, whether it is
+         * hidden, off-screen, or covered by any combination of the windows above it.
+         */
+        bool isWindowEntirelyCovered(const IWindow* win)
+        {
+            return getVisibleRegion(win).empty();
+        }
+
+        bool isWindowEntirelyCovered(const WindowPtr& win)
+        {
+            return isWindowEntirelyCovered(win.get());
+        }
+
+        /**
+         * Returns true if a window in the tree of the given top-level window should not
+         * draw right now because none of it is visible. The window stays dirty, and
+         * draws once part of it is exposed. Only applies to RenderMode::Retained; the
+         * other modes only ever re-draw the visible part of the damage.
+         */
+        bool isDrawOccluded(const IWindow* topLevel)
+        {
+            return _config.renderMode == RenderMode::Retained &&
+                isWindowEntirelyCovered(topLevel);
+        }
+
+        /**
+         * Content damage: the windows under rect must be re-drawn, and then flushed to
+         * the display.
+         */
+        virtual void setDirtyRect(const Rect& rect)
+        {
+            _registry.forEach([=](const WindowPtr& win)
+            {
+                if (!win->isDrawable()) {
+                    return true;
+                }
+                if (win->getRect().intersectsRect(rect)) {
+                    const auto intersection = win->getRect().getIntersection(rect);
+                    EWM_LOG_V("dirty rect = {%hd, %hd, %hd, %hd}, intersection"
+                        " with %s is {%hd, %hd, %hd, %hd}", rect.left, rect.top, rect.right, rect.bottom,
+                        win->toString().c_str(), intersection.left, intersection.top, intersection.right,
+                        intersection.bottom);
+                    win->markRectDirty(intersection);
+                }
+                return true;
+            });
+        }
+
+        /**
+         * Exposure damage: the contents of the windows under rect are intact (e.g. they
+         * were covered by a window that is now hidden), and only need to be flushed to
+         * the display again.
+         */
+        virtual void setExposedRect(const Rect& rect)
+        {
+            _registry.forEach([&](const WindowPtr& win)
+            {
+                if (win->isDrawable() && win->getRect().intersectsRect(rect)) {
+                    win->markRectExposed(rect);
+                }
+                return true;
+            });
+        }
+
+        bool displayToWindow(const WindowPtr& win, Point& pt) const
+        {
+            const auto windowRect = win->getRect();
+            if (windowRect.pointWithin(pt.x, pt.y)) {
+                pt.x = pt.x - windowRect.left;
+                pt.y = pt.y - windowRect.top;
+                return true;
+            }
+            return false;
+        }
+
+        bool windowToDisplay(const WindowPtr& win, Point& pt) const
+        {
+            const auto windowRect = win->getRect();
+            const Rect clientRect(0, 0, windowRect.width(), windowRect.height());
+            if (clientRect.pointWithin(pt.x, pt.y)) {
+                pt.x = pt.x + windowRect.left;
+                pt.y = pt.y + windowRect.top;
+                return true;
+            }
+            return false;
+        }
+
+        bool displayToWindow(const WindowPtr& win, Rect& rect) const
+        {
+            Point topLeft(rect.left, rect.top);
+            Point bottomRight(rect.right, rect.bottom);
+            if (displayToWindow(win, topLeft) && displayToWindow(win, bottomRight)) {
+                rect.left   = topLeft.x;
+                rect.top    = topLeft.y;
+                rect.right  = bottomRight.x;
+                rect.bottom = bottomRight.y;
+                return true;
+            }
+            return false;
+        }
+
+        bool windowToDisplay(const WindowPtr& win, Rect& rect) const
+        {
+            Point topLeft(rect.left, rect.top);
+            Point bottomRight(rect.right, rect.bottom);
+            if (windowToDisplay(win, topLeft) && windowToDisplay(win, bottomRight)) {
+                rect.left   = topLeft.x;
+                rect.top    = topLeft.y;
+                rect.right  = bottomRight.x;
+                rect.bottom = bottomRight.y;
+                return true;
+            }
+            return false;
+        }
+
+        virtual void render()
+        {
+# if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
+            static constexpr uint32_t reportInterval = 30000U;
+            static uint32_t lastReport = 0;
+            const auto beginTime = micros();
+# endif
+            bool updated = false;
+            if (bitsHigh(getState(), WMState::SSaverEnabled)) {
+                if (millis() - _ssLastActivity >= _ssTimerMsec) {
+                    if (!bitsHigh(getState(), WMState::SSaverActive)) {
+                        setState(getState() | WMState::SSaverActive);
+                        EWM_LOG_D("activated screensaver");
+                    }
+                } else {
+                    if (bitsHigh(getState(), WMState::SSaverActive)) {
+                        setState(getState() & ~(WMState::SSaverActive | WMState::SSaverDrawn));
+                        setExposedRect(getDisplayRect());
+                        EWM_LOG_D("de-activated screensaver");
+                    }
+                }
+            }
+            if (bitsHigh(getState(), WMState::SSaverActive)) {
+                if (!bitsHigh(getState(), WMState::SSaverDrawn)) {
+                    _flushQueue.waitIdle();
+                    _theme->drawScreensaver(_gfxDisplay);
+                    _invalidateTileHashes();
+                    updated = true;
+                    setState(getState() | WMState::SSaverDrawn);
+                }
+            } else {
+                _registry.forEach([](const WindowPtr& win)
+                {
+                    while (win->processQueue()) { }
+                    return true;
+                });
+                if (_visibleRegionsStale) {
+                    _updateVisibleRegions();
+                }
+                if (_config.renderMode == RenderMode::Retained) {
+                    updated = _renderRetained();
+                } else {
+                    updated = _renderReplayed();
+                }
+            }
+            if (updated) {
+                _flushQueue.endFrame();
+            }
+# if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
+            if (millis() - lastReport > reportInterval) {
+                _renderAccumCount = max(1U, _renderAccumCount);
+                _renderAvg        = _renderAccumTime / _renderAccumCount;
+                _renderAccumTime  = 0U;
+                _renderAccumCount = 0U;
+                EWM_LOG_V("avg. render time: %uμs", _renderAvg);
+                lastReport = millis();
+                return;
+            }
+            _renderAccumTime += micros() - beginTime;
+            _renderAccumCount++;
+# endif
+        }
+
+        /**
+         * Returns the window that a handle refers to, wherever it is in the tree, or
+         * nullptr if the window has since been destroyed.
+         */
+        WindowPtr getWindow(WindowHandle handle) const
+        {
+            return _handles.get(handle);
+        }
+
+        /** Invalidates a destroyed window's handle. */
+        void releaseHandle(WindowHandle handle)
+        {
+            _handles.remove(handle);
+        }
+
+        RenderMode getRenderMode() const noexcept { return _config.renderMode; }
+
+        /**
+         * Returns the number of times a window's onDraw() has been called. Sampled
+         * before and after an invalidation and render(), it gives the cost of the
+         * invalidation in re-draws.
+         */
+        uint32_t getDrawCount() const noexcept { return _drawCount; }
+        void countDraw() noexcept { _drawCount++; }
+
+        /**
+         * Returns the context that all windows draw into when they have no buffers of
+         * their own (i.e., in any render mode but RenderMode::Retained).
+         */
+        GfxContextPtr getGfxView() const noexcept { return _view; }
+
+        /**
+         * Returns true if windows must not draw right now, but instead report the area
+         * to be re-drawn, which render() will then have them draw into the view.
+         */
+        bool isDrawDeferred() const noexcept
+        {
+            return _config.renderMode != RenderMode::Retained && !_rasterizing;
+        }
+
+        /** Blocks until every rect queued by render() has reached the display. */
+        void waitForFlush()
+        {
+            _flushQueue.waitIdle();
+        }
+
+        /**
+         * Blocks until no pending flush reads from the given rect (in buffer
+         * coordinates) of ctx. Windows call this before drawing into their context.
+         */
+        void waitForFlush(const GfxContextPtr& ctx, const Rect& rect)
+        {
+            _flushQueue.waitForRect(ctx.get(), rect);
+        }
+
+        template<typename... TDisplayArgs>
+        inline bool begin(uint8_t rotation, TDisplayArgs&&... args)
+        {
+            bool success = _gfxDisplay != nullptr;
+            EWM_ASSERT(success);
+# if defined(EWM_GFX_FBDEV)
+            if (success && _config.renderMode == RenderMode::Panel && _config.pageFlip) {
+                _gfxDisplay->setPageCount(2);
+            }
+# endif
+            if (success) {
+                if constexpr (std::is_same_v<decltype(_gfxDisplay->begin(args...)), bool>) {
+                    success = _gfxDisplay->begin(args...);
+                } else {
+                    _gfxDisplay->begin(args...);
+                }
+            }
+            if (success) {
+                _gfxDisplay->setRotation(rotation);
+                _gfxDisplay->setCursor(0, 0);
+                _theme->setDisplayExtents(getDisplayWidth(), getDisplayHeight());
+                EWM_LOG_D("display: %hux%hu, rotation: %hhu", getDisplayWidth(),
+                    getDisplayHeight(), rotation);
+                success = _createRenderTarget(rotation);
+            }
+            if (success && _config.tileHash) {
+                _createTileHashes();
+            }
+            if (success && _config.calibrateFlush) {
+                _calibrateFlushCost();
+            }
+            if (success) {
+                _flushQueue.start();
+            }
+            return success;
         }
 
-        bool setForegroundWindow(const WindowPtr& win)
+    private:
+        /** Returns a new window, or nullptr if the window pool is exhausted. */
+        template<class TWindow, typename... TArgs>
+        static std::shared_ptr<TWindow> _newWindow(TArgs&&... args)
         {
-            return _registry->setForegroundWindow(win);
+# if defined(EWM_STATIC_POOLS)
+            auto& pool = getWindowPool();
+            if (pool.available() == 0) {
+                return nullptr;
+            }
+            return std::allocate_shared<TWindow>(PoolAllocator<TWindow, WindowPool>(pool),
+                std::forward<TArgs>(args)...);
+# else
+            return std::make_shared<TWindow>(std::forward<TArgs>(args)...);
+# endif
         }
 
-        void hitTest(Coord x, Coord y)
+        /** Returns an off-screen 565 canvas for the render target. */
+        GfxContextPtr _createOffscreen(Extent width, Extent height)
         {
-            if (millis() - _lastHitTestTime < _config.minHitTestIntervalMsec) {
-                return;
-            }
-            EWM_ASSERT(x >= 0 && y >= 0);
-            EWM_ASSERT(x <= getDisplayWidth() && y <= getDisplayHeight());
-            EWM_LOG_D("hit test at %hd,%hd", x, y);
-            if (bitsHigh(getState(), WMState::SSaverEnabled)) {
-                _ssLastActivity = millis();
-                if (bitsHigh(getState(), WMState::SSaverActive)) {
-                    return;
+# if defined(EWM_STATIC_POOLS)
+            const auto count  = static_cast<size_t>(width) * height;
+            const auto pixels = getPixelPool().allocate(count);
+            if (pixels == nullptr) {
+                if (count > PixelPool::Capacity) {
+                    EWM_LOG_E("%hux%hu canvas needs %zu pixels, pool holds %zu (EWM_POOL_PIXELS)",
+                        width, height, count, PixelPool::Capacity);
+                } else {
+                    EWM_LOG_E("pixel pool exhausted (needs %zu pixels, %zu of %zu available)",
+                        count, getPixelPool().available(), PixelPool::Capacity);
                 }
+                return nullptr;
             }
-            [[maybe_unused]] bool claimed = false;
-            _registry->forEachChildReverse([&](const WindowPtr& child)
+            return std::make_shared<GfxView>(pixels, width, height);
+# else
+            return createGfxContext(width, height);
+# endif
+        }
+
+        bool _renderRetained()
+        {
+            bool updated = false;
+            auto visible = _visibleRegions.cbegin();
+            _registry.forEach([&](const WindowPtr& win)
             {
-                if (!child->isDrawable()) {
+                EWM_ASSERT(visible != _visibleRegions.cend() && visible->window == win.get());
+                const auto& visibleRegion = (visible++)->region;
+                if (!win->isDrawable()) {
                     return true;
                 }
-                EWM_LOG_V("interrogating %s re: hit test at %hd,%hd",
-                    child->toString().c_str(), x, y);
-                InputParams params;
-                params.type = InputType::Tap;
-                params.x    = x;
-                params.y    = y;
-                if (child->processInput(&params)) {
-                    EWM_LOG_V("%s claimed hit test at %hd,%hd",
-                        params.handledBy.c_str(), x, y);
-                    claimed = true;
-                    return false;
+                const auto dirtyRegion = win->getDirtyRegion();
+                if (dirtyRegion.empty()) {
+                    return true;
+                }
+                if (!visibleRegion.intersects(dirtyRegion.getBounds())) {
+                    EWM_LOG_V("%s is obscured where dirty; clearing dirty rects",
+                        win->toString().c_str());
+                    win->markRectDirty(Rect());
+                    win->setDirty(false);
+                    return true;
+                }
+                if (bitsHigh(win->getState(), State::Deferred)) {
+                    EWM_LOG_V("%s exposed; drawing deferred content", win->toString().c_str());
+                    win->redraw(true);
+                }
+                Region exposed;
+                for (const auto& rect : dirtyRegion) {
+                    auto visibleRect = visibleRegion;
+                    exposed.unite(visibleRect.intersect(rect));
+                }
+                for (const auto& dirtyRect : FlushPlan(exposed, visibleRegion, _config.flushCost)) {
+                    auto clientDirtyRect = dirtyRect;
+                    // Only children with content damage are re-drawn; for the rest,
+                    // the pixels in the off-screen buffer are still current.
+                    win->getChildren().forEach([=](const WindowPtr& win)
+                    {
+                        if (!win->isDrawable()) {
+                            return true;
+                        }
+                        if (win->isDirty() && win->getRect().intersectsRect(clientDirtyRect)) {
+                            win->redraw();
+                        }
+                        return true;
+                    });
+                    if (!displayToWindow(win, clientDirtyRect)) {
+                        EWM_ASSERT(!"failed to convert display to window coords");
+                        return true;
+                    }
+                    FlushJob job;
+                    job.ctx = win->getGfxContext();
+                    job.src = clientDirtyRect;
+                    job.dst = Point(dirtyRect.left, dirtyRect.top);
+                    _flushQueue.push(std::move(job));
+                    EWM_LOG_V("drew rect {%hd, %hd, %hd, %hd} (client: {%hd, %hd, %hd, %hd}) for %s",
+                        dirtyRect.left, dirtyRect.top, dirtyRect.right, dirtyRect.bottom,
+                        clientDirtyRect.left, clientDirtyRect.top, clientDirtyRect.right, clientDirtyRect.bottom,
+                        win->toString().c_str());
                 }
+                win->markRectDirty(Rect());
+                win->setDirty(false);
+                updated = true;
                 return true;
             });
-            if (!claimed) {
-                EWM_LOG_V("hit test at %hd,%hd unclaimed", x, y);
-            }
-            _lastHitTestTime = millis();
+            return updated;
         }
 
-        bool isWindowEntirelyCovered(const WindowPtr& win)
+        /**
+         * Renders without per-window buffers: collects the damage from every top-level
+         * window, then has the windows re-draw it into the render target.
+         */
+        bool _renderReplayed()
         {
-            bool covered = false;
-            const auto rect = win->getRect();
-            _registry->forEachChildReverse([&](const WindowPtr& other)
+            Region damage;
+            auto visible = _visibleRegions.cbegin();
+            _registry.forEach([&](const WindowPtr& win)
             {
-                if (other == win) {
-                    return false;
-                }
-                if (!other->isDrawable()) {
+                EWM_ASSERT(visible != _visibleRegions.cend() && visible->window == win.get());
+                const auto& visibleRegion = (visible++)->region;
+                if (!win->isDrawable()) {
                     return true;
                 }
-                if (rect.withinRect(other->getRect())) {
-                    covered = true;
-                    return false;
+                // Damage to a window where it is covered would only have the windows
+                // above it re-draw unchanged pixels.
+                for (const auto& rect : win->getDirtyRegion()) {
+                    auto exposed = visibleRegion;
+                    exposed.intersect(rect);
+                    for (const auto& exposedRect : exposed) {
+                        damage.unite(exposedRect);
+                    }
                 }
                 return true;
             });
-            return covered;
+            damage.intersect(getDisplayRect());
+            if (damage.empty()) {
+                return false;
+            }
+            switch (_config.renderMode) {
+                case RenderMode::Panel:
+                    _renderPanel(damage);
+                    break;
+                case RenderMode::Shared:
+                    _renderShared(damage);
+                    break;
+                case RenderMode::Banded:
+                    _renderBanded(damage);
+                    break;
+                case RenderMode::Direct:
+                    _replay(damage, Point(0, 0));
+                    break;
+                default:
+                    EWM_ASSERT(!"invalid render mode");
+                    break;
+            }
+            // Clears the damage, including what the windows reported about themselves
+            // while being replayed.
+            _registry.forEach([](const WindowPtr& win)
+            {
+                win->markRectDirty(Rect());
+                win->setDirty(false);
+                return true;
+            });
+            return true;
         }
 
-        virtual void setDirtyRect(const Rect& rect)
+        /**
+         * Has each top-level window (and its children) re-draw the portion of itself that
+         * is both visible and damaged into the view, back to front. `targetOrigin` is the
+         * position on the display of the top left of the view's target.
+         */
+        void _replay(const Region& damage, const Point& targetOrigin)
         {
-            _registry->forEachChild([=](const WindowPtr& win)
+            _rasterizing = true;
+            auto visible = _visibleRegions.cbegin();
+            _registry.forEach([&](const WindowPtr& win)
             {
-                if (!win->isDrawable()) {
+                EWM_ASSERT(visible != _visibleRegions.cend() && visible->window == win.get());
+                const auto& visibleRegion = (visible++)->region;
+                if (!win->isDrawable() || !visibleRegion.intersects(damage.getBounds())) {
                     return true;
                 }
-                if (win->getRect().intersectsRect(rect)) {
-                    const auto intersection = win->getRect().getIntersection(rect);
-                    EWM_LOG_V("dirty rect = {%hd, %hd, %hd, %hd}, intersection"
-                        " with %s is {%hd, %hd, %hd, %hd}", rect.left, rect.top, rect.right, rect.bottom,
-                        win->toString().c_str(), intersection.left, intersection.top, intersection.right,
-                        intersection.bottom);
-                    win->markRectDirty(intersection);
+                auto exposed = visibleRegion;
+                exposed.intersect(damage);
+                const auto winRect = win->getRect();
+                _view->setOrigin(winRect.left - targetOrigin.x, winRect.top - targetOrigin.y);
+                for (const auto& rect : exposed) {
+                    _view->setClipRect(Rect(
+                        rect.left - targetOrigin.x,
+                        rect.top - targetOrigin.y,
+                        rect.right - targetOrigin.x,
+                        rect.bottom - targetOrigin.y
+                    ));
+                    // Pixels that the window does not draw (e.g. outside of rounded
+                    // corners) are black, as they are in a freshly created buffer. On
+                    // the display itself, that would be overdraw (and flicker).
+                    if (_config.renderMode != RenderMode::Direct) {
+                        _view->fillRect(rect.left - winRect.left, rect.top - winRect.top,
+                            rect.width(), rect.height(), 0);
+                    }
+                    // Tells the windows (and the theme) which part of them is needed.
+                    _theme->setClipRect(Rect(
+                        rect.left - winRect.left,
+                        rect.top - winRect.top,
+                        rect.right - winRect.left,
+                        rect.bottom - winRect.top
+                    ));
+                    win->redraw(true);
                 }
                 return true;
             });
+            _theme->setClipRect(Rect());
+            _view->setClipRect(Rect());
+            _rasterizing = false;
         }
 
-        bool displayToWindow(const WindowPtr& win, Point& pt) const
+        void _renderPanel(const Region& damage)
+        {
+            const auto stride = _getPanelStride();
+            if (_getPanelPageCount() > 1) {
+                // Bring the back page up to date with what changed in the previous
+                // frame (which was composed into the current front page), except for
+                // what is about to be re-drawn anyway.
+                const auto front = _getPanelPage(_getPanelFrontPage());
+                const auto back  = _getPanelPage(_getPanelFrontPage() ^ 1);
+                auto stale = _panelPrevDamage;
+                stale.subtract(damage);
+                for (const auto& rect : stale) {
+                    for (Coord row = rect.top; row < rect.bottom; row++) {
+                        const size_t offset = (row * stride) + rect.left;
+                        memcpy(back + offset, front + offset, rect.width() * sizeof(Color));
+                    }
+                }
+                _view->setBuffer(back);
+                _replay(damage, Point(0, 0));
+                _flipPanel();
+                _panelPrevDamage = damage;
+            } else {
+                _replay(damage, Point(0, 0));
+            }
+            _syncPanel(damage);
+        }
+
+        void _renderShared(const Region& damage)
         {
-            const auto windowRect = win->getRect();
-            if (windowRect.pointWithin(pt.x, pt.y)) {
-                pt.x = pt.x - windowRect.left;
-                pt.y = pt.y - windowRect.top;
-                return true;
+            for (const auto& rect : damage) {
+                _flushQueue.waitForRect(_target.get(), rect);
+            }
+            _replay(damage, Point(0, 0));
+            // The buffer mirrors the display, so any of it may be sent.
+            const Region display(getDisplayRect());
+            for (const auto& rect : FlushPlan(damage, display, _config.flushCost)) {
+                FlushJob job;
+                job.ctx = _target;
+                job.src = rect;
+                job.dst = rect.getTopLeft();
+                _flushQueue.push(std::move(job));
             }
-            return false;
         }
 
-        bool windowToDisplay(const WindowPtr& win, Point& pt) const
+        void _renderBanded(const Region& damage)
         {
-            const auto windowRect = win->getRect();
-            const Rect clientRect(0, 0, windowRect.width(), windowRect.height());
-            if (clientRect.pointWithin(pt.x, pt.y)) {
-                pt.x = pt.x + windowRect.left;
-                pt.y = pt.y + windowRect.top;
-                return true;
+            const auto bounds = damage.getBounds();
+            auto height       = _target->height();
+            Coord first       = bounds.top;
+            if (!_tileHashes.empty() && height >= EWM_TILE_SIZE) {
+                // Keep the bands on tile boundaries, so that no tile is flushed in pieces
+                // (which would never match the hash of the previous piece).
+                height -= height % EWM_TILE_SIZE;
+                first  -= first % EWM_TILE_SIZE;
+            }
+            for (Coord top = first; top < bounds.bottom; top += height) {
+                const Rect bandRect(0, top, getDisplayWidth(),
+                    min(Coord(top + height), Coord(getDisplayHeight())));
+                auto damaged = damage;
+                damaged.intersect(bandRect);
+                if (damaged.empty()) {
+                    continue;
+                }
+                // The strip only holds what is re-drawn, so the planned rects are what
+                // gets re-drawn.
+                Region band;
+                for (const auto& rect : FlushPlan(damaged, Region(bandRect), _config.flushCost)) {
+                    band.unite(rect);
+                }
+                if (_backTarget) {
+                    // Draw into one strip while the other one is being flushed.
+                    std::swap(_target, _backTarget);
+                    _view->setBuffer(getGfxBuffer(_target));
+                }
+                _flushQueue.waitForRect(_target.get(), Rect(0, 0, _target->width(), height));
+                // Merging (and alignment) may reach past the windows, which do not
+                // clear what the previous band left there.
+                _view->setOrigin(0, 0);
+                _view->setClipRect(Rect(0, 0, _target->width(), height));
+                for (const auto& rect : band) {
+                    _view->fillRect(rect.left, rect.top - top, rect.width(), rect.height(), 0);
+                }
+                _replay(band, Point(0, top));
+                for (const auto& rect : band) {
+                    FlushJob job;
+                    job.ctx = _target;
+                    job.src = Rect(rect.left, rect.top - top, rect.right, rect.bottom - top);
+                    job.dst = rect.getTopLeft();
+                    _flushQueue.push(std::move(job));
+                }
             }
-            return false;
         }
 
-        bool displayToWindow(const WindowPtr& win, Rect& rect) const
+        /** Returns the given page of the display's framebuffer, if it has one. */
+        Color* _getPanelPage([[maybe_unused]] uint8_t page) const
         {
-            Point topLeft(rect.left, rect.top);
-            Point bottomRight(rect.right, rect.bottom);
-            if (displayToWindow(win, topLeft) && displayToWindow(win, bottomRight)) {
-                rect.left   = topLeft.x;
-                rect.top    = topLeft.y;
-                rect.right  = bottomRight.x;
-                rect.bottom = bottomRight.y;
-                return true;
+# if defined(EWM_GFX_FBDEV)
+            if (_gfxDisplay->getBitsPerPixel() != 16) {
+                return nullptr;
             }
-            return false;
+            return reinterpret_cast<Color*>(_gfxDisplay->getPage(page));
+# elif defined(EWM_GFX_ARDUINO)
+            return _gfxDisplay->getFramebuffer();
+# else
+            return nullptr;
+# endif
         }
 
-        bool windowToDisplay(const WindowPtr& win, Rect& rect) const
+        Extent _getPanelStride() const
         {
-            Point topLeft(rect.left, rect.top);
-            Point bottomRight(rect.right, rect.bottom);
-            if (windowToDisplay(win, topLeft) && windowToDisplay(win, bottomRight)) {
-                rect.left   = topLeft.x;
-                rect.top    = topLeft.y;
-                rect.right  = bottomRight.x;
-                rect.bottom = bottomRight.y;
-                return true;
+# if defined(EWM_GFX_FBDEV)
+            return static_cast<Extent>(_gfxDisplay->getLineLength() / sizeof(Color));
+# else
+            return getDisplayWidth();
+# endif
+        }
+
+        uint8_t _getPanelPageCount() const
+        {
+# if defined(EWM_GFX_FBDEV)
+            return _gfxDisplay->getPageCount();
+# else
+            return 1U;
+# endif
+        }
+
+        uint8_t _getPanelFrontPage() const
+        {
+# if defined(EWM_GFX_FBDEV)
+            return _gfxDisplay->getFrontPage();
+# else
+            return 0U;
+# endif
+        }
+
+        void _flipPanel()
+        {
+# if defined(EWM_GFX_FBDEV)
+            _gfxDisplay->flip();
+# endif
+        }
+
+        /** Makes pixels written straight into the panel framebuffer visible. */
+        void _syncPanel([[maybe_unused]] const Region& damage)
+        {
+# if defined(EWM_GFX_ARDUINO) && defined(EWM_HAVE_ROM_CACHE)
+            // The panel is refreshed by DMA from PSRAM, so the dirty cache lines
+            // covering each rect must be written back.
+            const auto fb     = _getPanelPage(0);
+            const auto stride = _getPanelStride();
+            for (const auto& rect : damage) {
+                const auto first = fb + (rect.top * stride) + rect.left;
+                const auto last  = fb + ((rect.bottom - 1) * stride) + rect.right;
+                Cache_WriteBack_Addr(reinterpret_cast<uint32_t>(first),
+                    (last - first) * sizeof(Color));
             }
-            return false;
+# endif
         }
 
-        virtual void render()
+        /** Creates the view that windows draw into, if the render mode calls for one. */
+        bool _createRenderTarget(uint8_t rotation)
         {
-# if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
-            static constexpr uint32_t reportInterval = 30000U;
-            static uint32_t lastReport = 0;
-            const auto beginTime = micros();
+# if defined(EWM_STATIC_POOLS)
+            getPixelPool().reset();
 # endif
-            bool updated = false;
-            if (bitsHigh(getState(), WMState::SSaverEnabled)) {
-                if (millis() - _ssLastActivity >= _ssTimerMsec) {
-                    if (!bitsHigh(getState(), WMState::SSaverActive)) {
-                        setState(getState() | WMState::SSaverActive);
-                        EWM_LOG_D("activated screensaver");
+            switch (_config.renderMode) {
+                case RenderMode::Retained:
+# if defined(EWM_STATIC_POOLS)
+                    EWM_LOG_E("RenderMode::Retained is unavailable with EWM_STATIC_POOLS");
+                    return false;
+# else
+                    return true;
+# endif
+                case RenderMode::Panel: {
+                    const auto fb = _getPanelPage(_getPanelFrontPage());
+                    if (fb == nullptr) {
+                        EWM_LOG_E("display has no 16bpp framebuffer to render into");
+                        return false;
                     }
-                } else {
-                    if (bitsHigh(getState(), WMState::SSaverActive)) {
-                        setState(getState() & ~(WMState::SSaverActive | WMState::SSaverDrawn));
-                        setDirtyRect(getDisplayRect());
-                        EWM_LOG_D("de-activated screensaver");
+                    if (rotation != 0) {
+                        EWM_LOG_E("rotation %hhu unsupported when rendering into the panel",
+                            rotation);
+                        return false;
+                    }
+                    if (_config.pageFlip && _getPanelPageCount() < 2) {
+                        EWM_LOG_W("display has a single page; not page flipping");
+                    }
+                    _view = std::make_shared<GfxView>(fb, _getPanelStride(), getDisplayHeight());
+                    EWM_LOG_D("rendering into the panel framebuffer (%hhu page(s))",
+                        _getPanelPageCount());
+                    return true;
+                }
+                case RenderMode::Shared:
+                    _target = _createOffscreen(getDisplayWidth(), getDisplayHeight());
+                    if (!_target || getGfxBuffer(_target) == nullptr) {
+                        EWM_LOG_E("failed to allocate %hux%hu shared buffer",
+                            getDisplayWidth(), getDisplayHeight());
+                        return false;
+                    }
+                    _view = std::make_shared<GfxView>(getGfxBuffer(_target),
+                        getGfxStride(_target), getDisplayHeight());
+                    EWM_LOG_D("rendering into a shared %hux%hu buffer", getDisplayWidth(),
+                        getDisplayHeight());
+                    return true;
+                case RenderMode::Banded: {
+                    const auto height = max(Extent(1), min(_config.bandHeight, getDisplayHeight()));
+                    _target = _createOffscreen(getDisplayWidth(), height);
+# if defined(EWM_ASYNC_FLUSH)
+                    _backTarget = _createOffscreen(getDisplayWidth(), height);
+                    if (!_backTarget || getGfxBuffer(_backTarget) == nullptr) {
+                        _backTarget.reset();
+                    }
+# endif
+                    if (!_target || getGfxBuffer(_target) == nullptr) {
+                        EWM_LOG_E("failed to allocate %hux%hu strip buffer", getDisplayWidth(),
+                            height);
+                        return false;
                     }
+                    _view = std::make_shared<GfxView>(getGfxBuffer(_target),
+                        getGfxStride(_target), height);
+                    EWM_LOG_D("rendering in bands of %hu lines", height);
+                    return true;
                 }
+                case RenderMode::Direct:
+                    _view = std::make_shared<GfxView>(_gfxDisplay.get(), getDisplayWidth(),
+                        getDisplayHeight());
+                    EWM_LOG_D("rendering straight to the display");
+                    return true;
+                default:
+                    EWM_ASSERT(!"invalid render mode");
+                    return false;
             }
-            if (bitsHigh(getState(), WMState::SSaverActive)) {
-                if (!bitsHigh(getState(), WMState::SSaverDrawn)) {
-                    _theme->drawScreensaver(_gfxDisplay);
-                    updated = true;
-                    setState(getState() | WMState::SSaverDrawn);
+        }
+
+        void _flushRect(const FlushJob& job)
+        {
+            const auto& src    = job.src;
+            const auto& dst    = job.dst;
+            const auto stride  = getGfxStride(job.ctx);
+            const auto pixels  = getGfxSpan(job.ctx, src.left, src.top);
+            // When the rect spans the full width of the buffer, its rows are adjacent
+            // in memory and it can be sent with a single write.
+            [[maybe_unused]] const bool contiguous = src.width() == stride;
+# if defined(EWM_GFX_ADAFRUIT)
+#  if !defined(EWM_ADAFRUIT_RA8875)
+            _gfxDisplay->startWrite();
+            _gfxDisplay->setAddrWindow(dst.x, dst.y, src.width(), src.height());
+            if (contiguous) {
+                _writePixels(pixels, src.width() * src.height());
+            } else {
+                // The address window is already set; the rows just need to be sent
+                // back to back.
+                for (Coord row = 0; row < src.height(); row++) {
+                    _writePixels(pixels + (row * stride), src.width());
+                }
+            }
+            _gfxDisplay->endWrite();
+#  else
+            if (contiguous && _gfxDisplay->getRotation() == 0) {
+                // Memory writes wrap at the edges of the active window, so one write
+                // fills the whole rect.
+                _setRA8875ActiveWindow(dst.x, dst.y, dst.x + src.width() - 1,
+                    dst.y + src.height() - 1);
+                _gfxDisplay->drawPixels(pixels, src.width() * src.height(), dst.x, dst.y);
+                _setRA8875ActiveWindow(0, 0, _gfxDisplay->width() - 1,
+                    _gfxDisplay->height() - 1);
+            } else {
+                for (Coord row = 0; row < src.height(); row++) {
+                    _gfxDisplay->drawPixels(pixels + (row * stride), src.width(), dst.x,
+                        dst.y + row);
+                }
+            }
+#  endif
+# elif defined(EWM_GFX_FBDEV)
+            _gfxDisplay->writeRect(dst.x, dst.y, pixels, stride, src.width(), src.height());
+# else
+            _gfxDisplay->startWrite();
+            if (contiguous) {
+                _gfxDisplay->draw16bitRGBBitmap(dst.x, dst.y, pixels, src.width(),
+                    src.height());
+            } else {
+                for (Coord row = 0; row < src.height(); row++) {
+                    _gfxDisplay->draw16bitRGBBitmap(dst.x, dst.y + row,
+                        pixels + (row * stride), src.width(), 1);
+                }
+            }
+            _gfxDisplay->endWrite();
+# endif
+        }
+
+        /**
+         * Divides the display into tiles, and keeps a hash of what was last flushed to
+         * each, so that re-drawing identical pixels does not cost a transfer.
+         */
+        void _createTileHashes()
+        {
+            if (_config.renderMode == RenderMode::Panel ||
+                _config.renderMode == RenderMode::Direct) {
+                EWM_LOG_W("tile hashes unused: render mode does not flush");
+                return;
+            }
+            _tileColumns = (getDisplayWidth() + EWM_TILE_SIZE - 1) / EWM_TILE_SIZE;
+            const Extent rows = (getDisplayHeight() + EWM_TILE_SIZE - 1) / EWM_TILE_SIZE;
+            const size_t count = static_cast<size_t>(_tileColumns) * rows;
+            _tileHashes.clear();
+# if defined(EWM_STATIC_POOLS)
+            if (count > _tileHashes.capacity()) {
+                EWM_LOG_W("tile hashes unused: %zu tiles needed, EWM_POOL_TILES is %zu",
+                    count, _tileHashes.capacity());
+                return;
+            }
+            for (size_t idx = 0; idx < count; idx++) {
+                _tileHashes.push_back(0U);
+            }
+# else
+            _tileHashes.resize(count, 0U);
+# endif
+            EWM_LOG_D("tracking %zu tiles of %dx%d", count, EWM_TILE_SIZE, EWM_TILE_SIZE);
+        }
+
+        /**
+         * Measures the cost model of transfers to the display by timing a batch of
+         * one-pixel transfers (nearly all overhead), then a batch of large ones (nearly
+         * all payload). Writes the top of the render target (i.e., black) to the display.
+         */
+        void _calibrateFlushCost()
+        {
+            if (_config.renderMode == RenderMode::Panel ||
+                _config.renderMode == RenderMode::Direct) {
+                return;
+            }
+            EWM_CONST(uint32_t, Transfers, 32U);
+            EWM_CONST(Extent, MaxRows, 32);
+            const Extent rows = min(MaxRows,
+                _target ? static_cast<Extent>(_target->height()) : getDisplayHeight());
+            auto ctx = _target ? _target : _createOffscreen(getDisplayWidth(), rows);
+            if (!ctx || getGfxBuffer(ctx) == nullptr) {
+                EWM_LOG_W("unable to calibrate flush cost; using defaults");
+                return;
+            }
+            FlushJob job;
+            job.ctx = ctx;
+            job.src = Rect(0, 0, 1, 1);
+            auto start = micros();
+            for (uint32_t idx = 0; idx < Transfers; idx++) {
+                _flushRect(job);
+            }
+            const float smallUs = static_cast<float>(micros() - start) / Transfers;
+            job.src = Rect(0, 0, getDisplayWidth(), rows);
+            start = micros();
+            for (uint32_t idx = 0; idx < Transfers / 8; idx++) {
+                _flushRect(job);
+            }
+            const float largeUs = static_cast<float>(micros() - start) / (Transfers / 8);
+            // The large transfer sends width * rows pixels, the small one a single pixel.
+            const float pixels  = (static_cast<float>(job.src.width()) * rows) - 1.0f;
+            const float bytes   = pixels * sizeof(Color);
+            if (largeUs <= smallUs) {
+                EWM_LOG_W("flush timings inconclusive (%.2fμs, %.2fμs); using defaults",
+                    smallUs, largeUs);
+                return;
+            }
+            auto& cost      = _config.flushCost;
+            cost.bytesPerUs = bytes / (largeUs - smallUs);
+            cost.overheadUs = max(0.0f, smallUs - (sizeof(Color) / cost.bytesPerUs));
+            EWM_LOG_D("flush cost: %.2fμs per transfer, %.2f bytes/μs", cost.overheadUs,
+                cost.bytesPerUs);
+        }
+
+        /** Forgets what was flushed, e.g. after drawing to the display directly. */
+        void _invalidateTileHashes()
+        {
+            std::fill(_tileHashes.begin(), _tileHashes.end(), 0U);
+        }
+
+        /**
+         * Returns a hash (FNV-1a) of the pixels of src, seeded with the rect on the display
+         * that they are flushed to. Never returns zero, which means "unknown".
+         */
+        static uint32_t _hashPixels(const GfxContextPtr& ctx, const Rect& src,
+            const Rect& dst) noexcept
+        {
+            EWM_CONST(uint32_t, Prime, 16777619U);
+            uint32_t hash = 2166136261U;
+            for (const Coord coord : { dst.left, dst.top, dst.right, dst.bottom }) {
+                hash = (hash ^ static_cast<uint16_t>(coord)) * Prime;
+            }
+            const auto stride = getGfxStride(ctx);
+            const Color* row  = getGfxSpan(ctx, src.left, src.top);
+            for (Coord y = 0; y < src.height(); y++, row += stride) {
+                for (Coord x = 0; x < src.width(); x++) {
+                    hash = (hash ^ row[x]) * Prime;
+                }
+            }
+            return hash != 0U ? hash : 1U;
+        }
+
+        /**
+         * Transfers a job to the display. With tile hashes, only the runs of tiles that
+         * have changed since they were last flushed are sent; rows of tiles that have
+         * changed entirely are merged back into a single transfer. A tile only matches if
+         * the last thing flushed to it was the same part of it with the same pixels, so
+         * partially covered tiles are safe too.
+         */
+        void _flushJob(const FlushJob& job)
+        {
+            if (_tileHashes.empty()) {
+                _flushRect(job);
+                return;
+            }
+            const Rect dst(job.dst.x, job.dst.y, job.dst.x + job.src.width(),
+                job.dst.y + job.src.height());
+            EWM_ASSERT(dst.left >= 0 && dst.top >= 0);
+            const Coord offsetX = job.src.left - dst.left;
+            const Coord offsetY = job.src.top - dst.top;
+            auto toSrc = [&](const Rect& rect)
+            {
+                return Rect(rect.left + offsetX, rect.top + offsetY, rect.right + offsetX,
+                    rect.bottom + offsetY);
+            };
+            auto flush = [&](const Rect& rect)
+            {
+                if (!rect.empty()) {
+                    FlushJob part;
+                    part.ctx = job.ctx;
+                    part.src = toSrc(rect);
+                    part.dst = rect.getTopLeft();
+                    _flushRect(part);
                 }
-            } else {
-                _registry->forEachChild([&](const WindowPtr& win)
-                {
-                    while (win->processQueue()) { }
-                    if (!win->isDrawable()) {
-                        return true;
-                    }
-                    auto dirtyRect = win->getDirtyRect();
-                    if (dirtyRect.empty()) {
-                        return true;
-                    }
-                    bool obscuringRectSet = false;
-                    Rect obscuringRect;
-                    _registry->forEachChildReverse([&](const WindowPtr& above)
-                    {
-                        if (win == above) {
-                            return false;
-                        }
-                        if (!above->isDrawable()) {
-                            return true;
-                        }
-                        const auto aboveRect = above->getRect();
-                        if (!obscuringRectSet) {
-                            obscuringRect = aboveRect;
-                            obscuringRectSet = true;
-                        } else {
-                            obscuringRect.mergeRect(aboveRect);
-                        }
-                        return true;
-                    });
-                    std::queue<Rect> dirtyRects;
-                    if (!obscuringRect.empty()) {
-                        dirtyRects = dirtyRect.subtractRect(obscuringRect);
-                        if (dirtyRects.empty()) {
-                            EWM_LOG_V("%s has no dirty rects left after subtracting the"
-                                " obscuring rect; clearing dirty rect", win->toString().c_str());
-                            win->markRectDirty(Rect());
-                            win->setDirty(false);
-                            return true;
+            };
+            EWM_CONST(Coord, TileSize, EWM_TILE_SIZE);
+            Rect changedRows(dst.left, dst.top, dst.right, dst.top);
+            for (Coord tileTop = (dst.top / TileSize) * TileSize; tileTop < dst.bottom;
+                tileTop += TileSize) {
+                const Coord top    = max(tileTop, dst.top);
+                const Coord bottom = min(Coord(tileTop + TileSize), dst.bottom);
+                const auto hashes  = &_tileHashes[(tileTop / TileSize) * _tileColumns];
+                Coord runLeft      = dst.left;
+                bool allChanged    = true;
+                for (Coord tileLeft = (dst.left / TileSize) * TileSize; tileLeft < dst.right;
+                    tileLeft += TileSize) {
+                    const Rect piece(max(tileLeft, dst.left), top,
+                        min(Coord(tileLeft + TileSize), dst.right), bottom);
+                    const auto hash = _hashPixels(job.ctx, toSrc(piece), piece);
+                    auto& known     = hashes[tileLeft / TileSize];
+                    if (known == hash) {
+                        if (allChanged) {
+                            flush(changedRows);
+                            allChanged = false;
                         }
+                        flush(Rect(runLeft, top, piece.left, bottom));
+                        runLeft = piece.right;
                     } else {
-                        dirtyRects.push(dirtyRect);
+                        known = hash;
                     }
+                }
+                if (allChanged) {
+                    changedRows.bottom = bottom;
+                } else {
+                    flush(Rect(runLeft, top, dst.right, bottom));
+                    changedRows = Rect(dst.left, bottom, dst.right, bottom);
+                }
+            }
+            flush(changedRows);
+        }
 
-                    while (!dirtyRects.empty()) {
-                        auto clientDirtyRect = dirtyRect = dirtyRects.front();
-                        dirtyRects.pop();
-                        win->forEachChild([=](const WindowPtr& win)
-                        {
-                            if (!win->isDrawable()) {
-                                return true;
-                            }
-                            if (win->getRect().intersectsRect(clientDirtyRect)) {
-                                win->setDirty(true);
-                                win->redraw();
-                                return true;
-                            }
-                            return true;
-                        });
-                        if (!displayToWindow(win, clientDirtyRect)) {
-                            EWM_ASSERT(!"failed to convert display to window coords");
-                            return true;
-                        }
-                        auto ctx = win->getGfxContext();
-# if defined(EWM_GFX_ADAFRUIT)
-#  if !defined(EWM_ADAFRUIT_RA8875)
-                        _gfxDisplay->startWrite();
-                        _gfxDisplay->setAddrWindow(
-                            dirtyRect.left,
-                            dirtyRect.top,
-                            dirtyRect.width(),
-                            dirtyRect.height()
-                        );
-                        for (auto line = clientDirtyRect.top; line < clientDirtyRect.bottom; line++) {
-                            const auto offset = getGfxBuffer(ctx) + (line * ctx->width()) + clientDirtyRect.left;
-                            _gfxDisplay->writePixels(offset, clientDirtyRect.width());
-                        }
-                        _gfxDisplay->endWrite();
+# if defined(EWM_GFX_ADAFRUIT) && !defined(EWM_ADAFRUIT_RA8875)
+        void _writePixels(Color* pixels, size_t count)
+        {
+#  if defined(EWM_SIMD_PIE)
+            // Swap into big-endian order with the vectorized kernel, so the library
+            // can send the pixels as they are. The copy starts at the same offset
+            // within 16 bytes as the source, which the kernel needs to vectorize.
+            const auto copySwapped = PixelKernels::get().copySwapped;
+            const size_t offset = (reinterpret_cast<uintptr_t>(pixels) & 15U) / sizeof(Color);
+            while (count > 0) {
+                const size_t chunk = min(count, _swapBuffer.size() - offset);
+                copySwapped(_swapBuffer.data() + offset, pixels, chunk);
+                _gfxDisplay->writePixels(_swapBuffer.data() + offset, chunk, true, true);
+                pixels += chunk;
+                count  -= chunk;
+            }
 #  else
-                        //_gfxDisplay->graphicsMode();
-                        //_gfxDisplay->startWrite();
-                        Coord row = dirtyRect.top;
-                        for (auto line = clientDirtyRect.top; line < clientDirtyRect.bottom; line++, row++) {
-                            const auto offset = getGfxBuffer(ctx) + (line * ctx->width()) + clientDirtyRect.left;
-                            //for (auto col = dirtyRect.left; col < dirtyRect.right; col++) {
-                            //_gfxDisplay->drawPixels(offset, clientDirtyRect.width(), dirtyRect.left, row);
-                                _gfxDisplay->drawRGBBitmap(
-                                    dirtyRect.left,
-                                    row,
-                                    offset,
-                                    dirtyRect.width(),
-                                    1
-                                );
-                            //}
-                        }
-                        //_gfxDisplay->endWrite();
+            _gfxDisplay->writePixels(pixels, count);
 #  endif
-# else
-                        /* _gfxDisplay->fillScreen(BLACK);
-                        srand(millis());
-                        auto x = min((int)getDisplayWidth(), rand() % getDisplayWidth());
-                        auto y = max(0, rand() % getDisplayHeight());
-                        _gfxDisplay->fillRect(
-                            x,
-                            y,
-                            getDisplayWidth() - x,
-                            getDisplayHeight() - y,
-                            0xf81f
-                        ); */
-
-                        /*_gfxDisplay->startWrite();
-                        Coord row = dirtyRect.top;
-                        for (auto line = clientDirtyRect.top; line < clientDirtyRect.bottom; line++, row++) {
-                            const auto offset = getGfxBuffer(ctx) + (line * ctx->width()) + clientDirtyRect.left;
-                              _gfxDisplay->draw16bitRGBBitmap(
-                                dirtyRect.left,
-                                row,
-                                offset,
-                                dirtyRect.width(),
-                                1
-                            );
-                            // Coord col = 0;
-
-                            //for (auto tmp = clientDirtyRect.left; tmp < clientDirtyRect.right; tmp++, col++) {
-                            //    _gfxDisplay->drawPixel(dirtyRect.left + col, row, *(offset + col));
-                            //}
-                        }
-                        _gfxDisplay->drawRect(
-                            dirtyRect.left - 1,
-                            dirtyRect.top - 1,
-                            dirtyRect.width() + 1,
-                            dirtyRect.height() + 1,
-                            0xf81f
-                        );
-                        _gfxDisplay->endWrite();
-                        _gfxDisplay->flush();*/
+        }
 # endif
-                        EWM_LOG_V("drew rect {%hd, %hd, %hd, %hd} (client: {%hd, %hd, %hd, %hd}) for %s",
-                            dirtyRect.left, dirtyRect.top, dirtyRect.right, dirtyRect.bottom,
-                            clientDirtyRect.left, clientDirtyRect.top, clientDirtyRect.right, clientDirtyRect.bottom,
-                            win->toString().c_str());
-                    }
-                    win->markRectDirty(Rect());
-                    win->setDirty(false);
-                    updated = true;
-                    return true;
-                });
-            }
-# if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
-            if (millis() - lastReport > reportInterval) {
-                _renderAccumCount = max(1U, _renderAccumCount);
-                _renderAvg        = _renderAccumTime / _renderAccumCount;
-                _renderAccumTime  = 0U;
-                _renderAccumCount = 0U;
-                EWM_LOG_V("avg. render time: %uμs", _renderAvg);
-                lastReport = millis();
-                return;
+
+# if defined(EWM_GFX_ADAFRUIT) && defined(EWM_ADAFRUIT_RA8875)
+        void _setRA8875ActiveWindow(Coord left, Coord top, Coord right, Coord bottom)
+        {
+            // HSAW0/1, VSAW0/1, HEAW0/1, VEAW0/1 (inclusive coordinates).
+            EWM_CONST(uint8_t, RegHSAW0, 0x30);
+            const Coord coords[] = { left, top, right, bottom };
+            for (size_t idx = 0; idx < 4; idx++) {
+                _gfxDisplay->writeReg(RegHSAW0 + (idx * 2), coords[idx] & 0xff);
+                _gfxDisplay->writeReg(RegHSAW0 + (idx * 2) + 1, (coords[idx] >> 8) & 0xff);
             }
-            _renderAccumTime += micros() - beginTime;
-            _renderAccumCount++;
-# endif
         }
+# endif
 
-        template<typename... TDisplayArgs>
-        inline bool begin(uint8_t rotation, TDisplayArgs&&... args)
+        struct VisibleRegion
         {
-            bool success = _gfxDisplay;
-            if (success) {
-                /// TODO: possible in C++11 to deduce return type
-                /// of begin() and capture it if it's bool?
-                _gfxDisplay->begin(args...);
-                _gfxDisplay->setRotation(rotation);
-                _gfxDisplay->setCursor(0, 0);
-            }
-            EWM_ASSERT(success);
-            if (success) {
-                _theme->setDisplayExtents(getDisplayWidth(), getDisplayHeight());
-                EWM_LOG_D("display: %hux%hu, rotation: %hhu", getDisplayWidth(),
-                    getDisplayHeight(), rotation);
-            }
-            return success;
+            const IWindow* window = nullptr;
+            Region region;
+        };
+
+        void _updateVisibleRegions()
+        {
+            // Walk top-down, accumulating the area covered by the windows above.
+            Region covered;
+            const auto displayRect = getDisplayRect();
+            _visibleRegions.clear();
+            _registry.forEachReverse([&](const WindowPtr& win)
+            {
+                VisibleRegion visible;
+                visible.window = win.get();
+                if (win->isDrawable()) {
+                    const auto rect = win->getRect().getIntersection(displayRect);
+                    visible.region = Region(rect);
+                    visible.region.subtract(covered);
+                    covered.unite(rect);
+                }
+                _visibleRegions.push_back(visible);
+                return true;
+            });
+            std::reverse(_visibleRegions.begin(), _visibleRegions.end());
+            _visibleRegionsStale = false;
         }
 
-    private:
         Config _config;
-        WindowContainerPtr _registry;
+        WindowContainer _registry;
+        HandleTable _handles;
+        GfxContextPtr _target;
+        GfxContextPtr _backTarget;
+        GfxViewPtr _view;
+        Region _panelPrevDamage;
+        bool _rasterizing          = false;
+# if defined(EWM_STATIC_POOLS)
+        StaticVector<VisibleRegion, EWM_POOL_CHILDREN> _visibleRegions;
+# else
+        std::deque<VisibleRegion> _visibleRegions;
+# endif
+        bool _visibleRegionsStale  = true;
         GfxDisplayPtr _gfxDisplay;
+# if defined(EWM_GFX_ADAFRUIT) && !defined(EWM_ADAFRUIT_RA8875) && defined(EWM_SIMD_PIE)
+        alignas(16) std::array<Color, 256 + (16 / sizeof(Color))> _swapBuffer;
+# endif
+        FlushQueue _flushQueue;
+# if defined(EWM_STATIC_POOLS)
+        StaticVector<uint32_t, EWM_POOL_TILES> _tileHashes;
+# else
+        std::vector<uint32_t> _tileHashes;
+# endif
+        Extent _tileColumns        = 0;
         ThemePtr _theme;
         WMState _state             = WMState::None;
         uint32_t _ssLastActivity   = 0U;
         uint32_t _ssTimerMsec      = 0U;
         uint32_t _lastHitTestTime  = 0U;
+        uint32_t _drawCount        = 0U;
 # if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
         uint32_t _renderAvg        = 0U;
         uint32_t _flushAvg         = 0U;
@@ -2129,12 +6182,23 @@ namespace exostra
     WindowManagerPtr createWindowManager(
         const std::shared_ptr<TGfxDisplay>& display,
         const std::shared_ptr<TTheme>& theme,
-        const Font* defaultFont
+        const Font* defaultFont,
+        const WindowManager::Config* config = nullptr
     )
     {
         static_assert(std::is_base_of<GfxDisplay, TGfxDisplay>::value);
         static_assert(std::is_base_of<ITheme, TTheme>::value);
-        return std::make_shared<WindowManager>(display, theme, defaultFont);
+# if defined(EWM_STATIC_POOLS)
+        auto& pool = getWMPool();
+        if (pool.available() == 0) {
+            EWM_LOG_E("only one window manager may exist with EWM_STATIC_POOLS");
+            return nullptr;
+        }
+        return std::allocate_shared<WindowManager>(PoolAllocator<WindowManager, WMPool>(pool),
+            display, theme, defaultFont, config);
+# else
+        return std::make_shared<WindowManager>(display, theme, defaultFont, config);
+# endif
     }
 
     class Window : public IWindow, public std::enable_shared_from_this<IWindow>
@@ -2148,44 +6212,48 @@ namespace exostra
             WindowID id,
             Style style,
             const Rect& rect,
-            const std::string& text
+            std::string_view text
 # if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
             , const char* className
 # endif
-        ) : _wm(wm), _parent(parent), _rect(rect), _dirtyRect(rect), _text(text),
+        ) : _wm(wm.get()), _parent(parent.get()), _rect(rect), _text(text),
 # if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
             _className(className),
 # endif
             _style(style), _id(id)
         {
-            if (bitsHigh(_style, Style::TopLevel) && !parent) {
-# if defined(EWM_GFX_ADAFRUIT)
-                _ctx = std::make_shared<GfxContext>(rect.width(), rect.height());
-# else
-#  pragma message("TODO_if_window_resized_recreate_gfx_ctx")
-                _ctx = std::make_shared<GfxContext>(
-                    rect.width(),
-                    rect.height(),
-                    nullptr,
-                    0,
-                    0
-                );
+            if (!parent) {
+                _dirtyRegion.add(rect);
+            }
+            if (bitsHigh(_style, Style::TopLevel) && !parent &&
+                wm->getRenderMode() != RenderMode::Retained) {
+                _ctx = wm->getGfxView();
                 EWM_ASSERT(_ctx);
-                if (_ctx) {
-                    _ctx->begin(GFX_SKIP_OUTPUT_BEGIN);
-                }
+                EWM_LOG_V("%s: using the window manager's gfx view", toString().c_str());
+            } else if (bitsHigh(_style, Style::TopLevel) && !parent) {
+# if defined(EWM_GFX_ARDUINO)
+#  pragma message("TODO_if_window_resized_recreate_gfx_ctx")
 # endif
+                _ctx = createGfxContext(rect.width(), rect.height());
                 EWM_LOG_V("%s: created %hux%hu gfx context",
                     toString().c_str(), rect.width(), rect.height());
             } else {
                 EWM_ASSERT(parent);
-                _ctx = parent->getGfxContext();
-                if (_ctx) {
-                    EWM_LOG_V("%s: using parents' %hux%hu gfx context",
-                        toString().c_str(), _ctx->width(), _ctx->height());
+                if (auto parentCtx = parent->getGfxContext()) {
+                    // The view clips to the window, but is as large as its target, so
+                    // that the graphics library never culls (or wraps text) any sooner
+                    // than it would have drawing into the target. It is a member, so
+                    // the pointer to it owns nothing.
+                    _view.emplace(parentCtx.get(), parentCtx->width(), parentCtx->height());
+                    _ctx = GfxContextPtr(GfxContextPtr(), &*_view);
+                    _updateView();
+                    EWM_LOG_V("%s: using a view of its parent's %hux%hu gfx context",
+                        toString().c_str(), parentCtx->width(), parentCtx->height());
                 }
             }
-            EWM_ASSERT(_ctx && getGfxBuffer(_ctx) != nullptr);
+            EWM_ASSERT(_ctx);
+            EWM_ASSERT(wm->getRenderMode() == RenderMode::Direct || parent ||
+                getGfxBuffer(_ctx) != nullptr);
             auto theme = _getTheme();
             EWM_ASSERT(theme);
             _bgColor     = theme->getColor(ColorID::WindowBg);
@@ -2220,78 +6288,87 @@ namespace exostra
             return _children.forEachChildReverse(cb);
         }
 
-        WindowPtr getParent() const override { return _parent; }
+        IWindow* getParent() const noexcept override { return _parent; }
 
         GfxContextPtr getGfxContext() const override { return _ctx; }
 
+        WindowContainer& getChildren() noexcept override { return _children; }
+
         Rect getRect() const noexcept override { return _rect; }
 
         void setRect(const Rect& rect) noexcept override
         {
             if (rect != _rect) {
                 _rect = rect;
+                _updateView();
+                _invalidateVisibleRegions();
                 redrawAsync();
             }
         }
 
+        /**
+         * Returns the rect that the window draws into: a child draws through a view of
+         * its parent's context whose origin is the child's top left corner, so this is
+         * the same for every window.
+         */
         Rect getClientRect() const noexcept override
         {
-            auto parent = getParent();
-            const auto rect = getRect();
-            if (bitsHigh(getStyle(), Style::TopLevel) && !parent) {
-                return Rect(0, 0, rect.width(), rect.height());
-            } else {
-                EWM_ASSERT(parent);
-                const auto parentRect = parent->getRect();
-                return Rect(
-                    rect.left - parentRect.left,
-                    rect.top - parentRect.top,
-                    (rect.left - parentRect.left) + rect.width(),
-                    (rect.top - parentRect.top) + rect.height()
-                );
-            }
+            return Rect(0, 0, _rect.width(), _rect.height());
         }
 
-        Rect getDirtyRect() const noexcept
+        Rect getDirtyRect() const noexcept override
         {
-            return _dirtyRect;
+            return _dirtyRegion.getBounds();
         }
 
-        void markRectDirty(const Rect& rect) noexcept
+        const DirtyRegion& getDirtyRegion() const noexcept override
         {
-            if (!rect.empty()) {
-                const auto windowRect = getRect();
-                auto updatedRect      = false;
-                if (rect.left >= windowRect.left &&
-                    (rect.left < _dirtyRect.left || _dirtyRect.left == 0)) {
-                    _dirtyRect.left = rect.left;
-                    updatedRect = true;
-                }
-                if (rect.top >= windowRect.top &&
-                    (rect.top < _dirtyRect.top || _dirtyRect.top == 0)) {
-                    _dirtyRect.top = rect.top;
-                    updatedRect = true;
-                }
-                if (rect.right <= windowRect.right && rect.right > _dirtyRect.right) {
-                    _dirtyRect.right = rect.right;
-                    updatedRect = true;
-                }
-                if (rect.bottom <= windowRect.bottom && rect.bottom > _dirtyRect.bottom) {
-                    _dirtyRect.bottom = rect.bottom;
-                    updatedRect = true;
-                }
-                if (updatedRect) {
-                    setDirty(true);
-                    forEachChild([=](const WindowPtr& child)
-                    {
-                        if (rect != child->getRect()) {
-                            child->markRectDirty(_dirtyRect);
-                        }
-                        return true;
-                    });
+            return _dirtyRegion;
+        }
+
+        /**
+         * Content damage: marks this window, and those of its descendants that intersect
+         * rect, as needing to be re-drawn. Damage only ever travels down the tree; the
+         * top-level window also records rect for flushing. An empty rect clears the
+         * recorded rects.
+         */
+        void markRectDirty(const Rect& rect) noexcept override
+        {
+            if (rect.empty()) {
+                _dirtyRegion.clear();
+                return;
+            }
+            const auto clipped = getRect().getIntersection(rect);
+            if (clipped.empty()) {
+                return;
+            }
+            setDirty(true);
+            if (!getParent()) {
+                _dirtyRegion.add(clipped);
+            }
+            _children.forEach([&](const WindowPtr& child)
+            {
+                if (child->isVisible() && child->getRect().intersectsRect(clipped)) {
+                    child->markRectDirty(clipped);
                 }
+                return true;
+            });
+        }
+
+        /**
+         * Exposure damage: rect must be flushed again, but needs no re-drawing. Only
+         * ever travels up the tree, to the top-level window.
+         */
+        void markRectExposed(const Rect& rect) noexcept override
+        {
+            const auto clipped = getRect().getIntersection(rect);
+            if (clipped.empty()) {
+                return;
+            }
+            if (auto parent = getParent()) {
+                parent->markRectExposed(clipped);
             } else {
-                _dirtyRect = Rect();
+                _dirtyRegion.add(clipped);
             }
         }
 
@@ -2301,24 +6378,36 @@ namespace exostra
         {
             if (style != _style) {
                 _style = style;
+                _invalidateVisibleRegions();
                 redrawAsync();
             }
         }
 
         WindowID getID() const noexcept override { return _id; }
 
+        WindowHandle getHandle() const noexcept override { return _handle; }
+        void setHandle(WindowHandle handle) noexcept override { _handle = handle; }
+
         uint8_t getZOrder() const noexcept override { return _zOrder; }
         void setZOrder(uint8_t zOrder) noexcept override { _zOrder = zOrder; }
 
         State getState() const noexcept override { return _state; }
         void setState(State state) noexcept override { _state = state; }
 
-        std::string getText() const override { return _text; }
+        const char* getText() const noexcept override { return _text.c_str(); }
 
-        void setText(const std::string& text) override
+        void setText(std::string_view text) override
         {
-            if (text != _text) {
-                _text = text;
+            if (text != _text.view()) {
+                _text.assign(text);
+                redrawAsync();
+            }
+        }
+
+        void setStaticText(const char* text) override
+        {
+            if (text != _text.c_str()) {
+                _text.assignStatic(text);
                 redrawAsync();
             }
         }
@@ -2395,8 +6484,35 @@ namespace exostra
                     if (!isDirty() && p1 == 0U) {
                         break;
                     }
-                    handled = onDraw(p1, p2);
+                    if (auto wm = _getWM()) {
+                        if (wm->isDrawDeferred()) {
+                            // Only this tree is damaged; render() re-draws whatever is
+                            // above it in the damaged area anyway.
+                            _getTopLevel()->markRectDirty(getRect());
+                            setDirty(false);
+                            handled = true;
+                            break;
+                        }
+                        if (wm->isDrawOccluded(_getTopLevel())) {
+                            setDirty(true);
+                            if (!getParent()) {
+                                setState(getState() | State::Deferred);
+                            }
+                            break;
+                        }
+                        auto topLevel = _getTopLevel();
+                        const auto topLevelRect = topLevel->getRect();
+                        auto rect = getRect();
+                        rect.offset(-topLevelRect.left, -topLevelRect.top);
+                        wm->waitForFlush(topLevel->getGfxContext(), rect);
+                        wm->countDraw();
+                    }
+                    _updateView();
+                    handled = _drawWindow(p1, p2);
                     setDirty(false);
+                    if (handled && !getParent()) {
+                        setState((getState() | State::Drawn) & ~State::Deferred);
+                    }
                     break;
                 case Message::PostDraw:
                     handled = onPostDraw(p1, p2);
@@ -2430,7 +6546,15 @@ namespace exostra
             pm.msg = msg;
             pm.p1  = p1;
             pm.p2  = p2;
+# if defined(EWM_STATIC_POOLS)
+            if (!_queue.push(pm)) {
+                EWM_LOG_W("%s: message queue full; dropped message %hhu", toString().c_str(),
+                    static_cast<uint8_t>(msg));
+                return false;
+            }
+# else
             _queue.push(pm);
+# endif
             return msg == Message::Input &&
                 getMsgParamLoWord(p1) == static_cast<MsgParamWord>(InputType::Tap);
         }
@@ -2445,7 +6569,7 @@ namespace exostra
                 _queue.pop();
                 routeMessage(pm.msg, pm.p1, pm.p2);
             }
-            forEachChild([&](const WindowPtr& child)
+            _children.forEach([&](const WindowPtr& child)
             {
                 child->processQueue();
                 return true;
@@ -2462,7 +6586,7 @@ namespace exostra
                 return false;
             }
             bool handled = false;
-            forEachChildReverse([&](const WindowPtr& child)
+            _children.forEachReverse([&](const WindowPtr& child)
             {
                 handled = child->processInput(params);
                 if (handled) {
@@ -2487,27 +6611,30 @@ namespace exostra
 
         bool redraw(bool force = false) override
         {
-            if (!isDrawable()) {
+            if (!isDrawable() || _isOccluded()) {
                 return false;
             }
-            bool redrawn = (isDirty() || force)
-                ? routeMessage(Message::Draw, force ? 1U : 0U) : false;
-            bool childRedrawn = false;
-            if (redrawn) {
-                forEachChild([](const WindowPtr& child)
-                {
-                    child->setDirty(true);
-                    return true;
-                });
+            // The theme's clip rect is in the parent's coordinates; this window, and
+            // its children, draw in this window's.
+            auto theme      = _getTheme();
+            const auto clip = theme ? theme->getClipRect() : Rect();
+            if (!clip.empty()) {
+                const auto origin = _getClientOrigin();
+                auto local        = clip;
+                local.offset(-origin.x, -origin.y);
+                theme->setClipRect(local);
             }
-            childRedrawn = redrawChildren(force);
-            return redrawn || childRedrawn;
+            const bool redrawn = _redraw(force);
+            if (!clip.empty()) {
+                theme->setClipRect(clip);
+            }
+            return redrawn;
         }
 
         bool redrawChildren(bool force = false) override
         {
             bool childRedrawn = false;
-            forEachChild([&](const WindowPtr& child)
+            _children.forEach([&](const WindowPtr& child)
             {
                 if (child->isDirty() || force) {
                     if (child->redraw(force)) {
@@ -2521,6 +6648,7 @@ namespace exostra
 
         void redrawAsync() override
         {
+            _displayList.invalidate();
             setDirty(true);
             queueMessage(Message::Draw);
         }
@@ -2530,15 +6658,27 @@ namespace exostra
             if (!isVisible()) {
                 return false;
             }
-            setStyle(getStyle() & ~Style::Visible);
+            _setVisible(false);
             auto wm = _getWM();
-            EWM_ASSERT(wm);
-            wm->setDirtyRect(getRect());
+            if (wm == nullptr) {
+                return true;
+            }
+            if (getParent()) {
+                // Children share their parent's buffer, so what was under them is gone.
+                wm->setDirtyRect(getRect());
+            } else {
+                wm->setExposedRect(getRect());
+            }
             return true;
         }
 
         bool show() noexcept override
         {
+            auto wm = _getWM();
+            if (wm == nullptr) {
+                // Destroyed.
+                return false;
+            }
             const auto topLevel = bitsHigh(getStyle(), Style::TopLevel);
             EWM_ASSERT(!topLevel || !getParent());
             if (!topLevel && isVisible()) {
@@ -2546,10 +6686,16 @@ namespace exostra
             }
             auto shown = true;
             if (topLevel) {
-                auto wm = _getWM();
                 shown = wm->setForegroundWindow(shared_from_this());
             }
-            setStyle(getStyle() | Style::Visible);
+            _setVisible(true);
+            if (topLevel && bitsHigh(getState(), State::Drawn)) {
+                // The buffer still holds the window as it was when hidden; only what
+                // has changed since needs to be re-drawn.
+                markRectExposed(getRect());
+                redraw();
+                return shown;
+            }
             markRectDirty(getRect());
             return redraw() && shown;
         }
@@ -2579,11 +6725,17 @@ namespace exostra
             }
         }
 
+        bool isOpaque() const noexcept override
+        {
+            return bitsHigh(getStyle(), Style::Opaque) && getCornerRadius() == 0;
+        }
+
         bool isDrawable() const noexcept override
         {
             const auto wm = _getWM();
             const auto parent = getParent();
-            return isVisible() &&
+            return wm != nullptr &&
+                   isVisible() &&
                    isAlive() &&
                    (!parent || (parent && parent->isDrawable())) &&
                    !getRect().outsideRect(wm->getDisplayRect());
@@ -2593,12 +6745,21 @@ namespace exostra
         {
             hide();
             bool destroyed = routeMessage(Message::Destroy);
-            forEachChild([&](const WindowPtr& child)
+            _children.forEach([&](const WindowPtr& child)
             {
                 destroyed &= child->destroy();
                 return true;
             });
             removeAllChildren();
+            auto wm = _getWM();
+            if (wm) {
+                wm->releaseHandle(_handle);
+            }
+            _handle = WH_INVALID;
+            // The application may hold on to this window for longer than the manager
+            // (or the parent) lives.
+            _wm     = nullptr;
+            _parent = nullptr;
             return destroyed;
         }
 
@@ -2631,12 +6792,19 @@ namespace exostra
             return true;
         }
 
-        // Message::Draw: p1 = 1 (force) || 0, p2 = 0.
+        // Message::Draw: p1 = 1 (force) || 0, p2 = 0. Only getDrawClip() needs drawing.
         bool onDraw(MsgParam p1, MsgParam p2) override
         {
             auto theme = _getTheme();
             EWM_ASSERT(theme);
-            theme->drawWindowBackground(_ctx, getClientRect(), getCornerRadius(), getBgColor());
+            if (getCornerRadius() == 0) {
+                // Opaque children are about to paint over their part of the background.
+                for (const auto& rect : _getBackgroundRegion()) {
+                    theme->drawWindowBackground(_ctx, rect, 0, getBgColor());
+                }
+            } else {
+                theme->drawWindowBackground(_ctx, getClientRect(), getCornerRadius(), getBgColor());
+            }
             if (bitsHigh(getStyle(), Style::Frame)) {
                 theme->drawWindowFrame(_ctx, getClientRect(), getCornerRadius(), getFrameColor());
             }
@@ -2651,7 +6819,19 @@ namespace exostra
         {
             auto parent = getParent();
             if (parent) {
-                parent->markRectDirty(getRect());
+                // Siblings above this window that overlap it were just drawn over. Those
+                // below were not, so this can't ping-pong between siblings.
+                const auto rect = getRect();
+                bool above = false;
+                parent->getChildren().forEach([&](const WindowPtr& sibling)
+                {
+                    if (above && sibling->isVisible() && sibling->getRect().intersectsRect(rect)) {
+                        sibling->setDirty(true);
+                    }
+                    above = above || sibling.get() == this;
+                    return true;
+                });
+                parent->markRectExposed(rect);
             }
             return true;
         }
@@ -2673,7 +6853,7 @@ namespace exostra
             return false;
         }
 
-        // Message::Event: p1 = EventType, p2 = child WindowID.
+        // Message::Event: p1 = EventType, p2 = child WindowHandle.
         bool onEvent(MsgParam p1, MsgParam p2) override { return true; }
 
         // Message::Resize: p1 = 0, p2 = 0.
@@ -2690,12 +6870,188 @@ namespace exostra
             return false;
         }
 
-        WindowManagerPtr _getWM() const { return _wm; }
+        WindowManager* _getWM() const noexcept { return _wm; }
 
-        ThemePtr _getTheme() const
+        /**
+         * Sets or clears Style::Visible without setStyle()'s re-draw: show() and hide()
+         * decide for themselves what has been damaged.
+         */
+        void _setVisible(bool visible) noexcept
         {
-            auto wm = _getWM();
-            return wm ? wm->getTheme() : nullptr;
+            const auto style = visible ? (_style | Style::Visible) : (_style & ~Style::Visible);
+            if (style == _style) {
+                return;
+            }
+            _style = style;
+            _invalidateVisibleRegions();
+        }
+
+        void _invalidateVisibleRegions() const noexcept
+        {
+            if (!getParent() && _wm) {
+                _wm->invalidateVisibleRegions();
+            }
+        }
+
+        /**
+         * Returns true if onDraw() only depends on state whose setters call
+         * redrawAsync(), so that what it drew may be recorded and replayed.
+         */
+        virtual bool isRecordable() const noexcept { return false; }
+
+        /**
+         * Returns the part of the client rect that the draw in progress is limited to
+         * (all of it, unless only part of the window has been damaged).
+         */
+        Rect getDrawClip() const
+        {
+            const auto clientRect = getClientRect();
+            const auto theme      = _getTheme();
+            const auto clip       = theme ? theme->getClipRect() : Rect();
+            if (clip.empty()) {
+                return clientRect;
+            }
+            if (!(clientRect.left < clip.right && clip.left < clientRect.right &&
+                  clientRect.top < clip.bottom && clip.top < clientRect.bottom)) {
+                return Rect();
+            }
+            return clientRect.getIntersection(clip);
+        }
+
+        /** redraw(), once the theme's clip rect is in this window's coordinates. */
+        bool _redraw(bool force)
+        {
+            if (getDrawClip().empty()) {
+                return false;
+            }
+            bool redrawn = (isDirty() || force)
+                ? routeMessage(Message::Draw, force ? 1U : 0U) : false;
+            bool childRedrawn = false;
+            if (redrawn) {
+                // onDraw() paints the whole window, over the top of its children.
+                _children.forEach([](const WindowPtr& child)
+                {
+                    if (child->isVisible()) {
+                        child->setDirty(true);
+                    }
+                    return true;
+                });
+            }
+            childRedrawn = redrawChildren(force);
+            return redrawn || childRedrawn;
+        }
+
+        /** Returns the position of this window within its parent's client rect. */
+        Point _getClientOrigin() const noexcept
+        {
+            const auto parent = getParent();
+            if (!parent) {
+                return Point(0, 0);
+            }
+            const auto parentRect = parent->getRect();
+            return Point(_rect.left - parentRect.left, _rect.top - parentRect.top);
+        }
+
+        /** Moves the view (if any) to where the window is in its parent. */
+        void _updateView() noexcept
+        {
+            if (!_view || !getParent()) {
+                return;
+            }
+            const auto origin = _getClientOrigin();
+            _view->setOrigin(origin.x, origin.y);
+            _view->setClipRect(Rect(origin.x, origin.y, origin.x + _rect.width(),
+                origin.y + _rect.height()));
+        }
+
+        IWindow* _getTopLevel() noexcept
+        {
+            IWindow* topLevel = this;
+            while (const auto parent = topLevel->getParent()) {
+                topLevel = parent;
+            }
+            return topLevel;
+        }
+
+        /**
+         * Returns true if this window is entirely covered by opaque siblings above it,
+         * in which case there is no point in drawing it.
+         */
+        bool _isOccluded() const
+        {
+            const auto parent = getParent();
+            if (parent == nullptr) {
+                return false;
+            }
+            Region uncovered(getRect());
+            bool above = false;
+            parent->getChildren().forEach([&](const WindowPtr& sibling)
+            {
+                if (above && sibling->isVisible() && sibling->isOpaque()) {
+                    uncovered.subtract(sibling->getRect());
+                }
+                above = above || sibling.get() == this;
+                return !uncovered.empty();
+            });
+            return uncovered.empty();
+        }
+
+        /**
+         * Returns the part of the client rect that is not covered by the client rects
+         * of opaque children, i.e. where they are going to paint.
+         */
+        Region _getBackgroundRegion()
+        {
+            Region background(getClientRect());
+            _children.forEach([&](const WindowPtr& child)
+            {
+                // Fragmenting the region any further costs more than it saves.
+                if (background.size() > Region::Capacity / 2) {
+                    return false;
+                }
+                if (child->isVisible() && child->isOpaque()) {
+                    auto childRect = child->getRect();
+                    childRect.offset(-_rect.left, -_rect.top);
+                    background.subtract(childRect);
+                }
+                return !background.empty();
+            });
+            return background;
+        }
+
+        ITheme* _getTheme() const noexcept
+        {
+            return _wm ? _wm->getTheme().get() : nullptr;
+        }
+
+        /**
+         * Draws the window by replaying its display list, if it has a current one;
+         * otherwise, calls onDraw() (recording it, if possible).
+         */
+        bool _drawWindow(MsgParam p1, MsgParam p2)
+        {
+            auto theme = _getTheme();
+            if (!DisplayList::Enabled || !theme || !isRecordable() || _children.hasChildren()) {
+                return onDraw(p1, p2);
+            }
+            const auto clientRect = getClientRect();
+            if (_displayList.isValid() && _displayList.getRect() == clientRect) {
+                _displayList.replay(_ctx, theme->getClipRect());
+                return routeMessage(Message::PostDraw);
+            }
+            // The whole window is recorded, so that the list is of use to any later clip.
+            const auto clip = theme->getClipRect();
+            theme->setClipRect(Rect());
+            if (!theme->setRecorder(&_displayList)) {
+                theme->setClipRect(clip);
+                return onDraw(p1, p2);
+            }
+            _displayList.begin(clientRect);
+            const bool drawn = onDraw(p1, p2);
+            theme->setRecorder(nullptr);
+            theme->setClipRect(clip);
+            _displayList.end(drawn);
+            return drawn;
         }
 
     private:
@@ -2704,24 +7060,33 @@ namespace exostra
 # if !defined(EWM_NOMUTEXES)
         Mutex _queueMtx;
 # endif
-        WindowManagerPtr _wm;
-        WindowPtr _parent;
+        /**
+         * Non-owning; null once destroyed. The window manager destroys every window
+         * when it is torn down (or itself destroyed).
+         */
+        WindowManager* _wm = nullptr;
+        /** Non-owning; null once destroyed, which a parent does to its children. */
+        IWindow* _parent   = nullptr;
+        /** A child's view of its parent's context (which _ctx then points to). */
+        std::optional<GfxView> _view;
         GfxContextPtr _ctx;
         Rect _rect;
-        Rect _dirtyRect;
-        std::string _text;
+        DirtyRegion _dirtyRegion;
+        WindowText _text;
+        DisplayList _displayList;
 # if EWM_LOG_LEVEL >= EWM_LOG_LEVEL_VERBOSE
         std::string _className;
 # endif
-        Style _style        = Style::None;
-        WindowID _id        = WID_INVALID;
-        uint8_t _zOrder     = 0;
-        State _state        = State::None;
-        Color _bgColor      = 0;
-        Color _textColor    = 0;
-        Color _frameColor   = 0;
-        Color _shadowColor  = 0;
-        Coord _cornerRadius = 0;
+        Style _style         = Style::None;
+        WindowID _id         = WID_INVALID;
+        WindowHandle _handle = WH_INVALID;
+        uint8_t _zOrder      = 0;
+        State _state         = State::None;
+        Color _bgColor       = 0;
+        Color _textColor     = 0;
+        Color _frameColor    = 0;
+        Color _shadowColor   = 0;
+        Coord _cornerRadius  = 0;
     };
 
     class Button : public Window
@@ -2742,7 +7107,7 @@ namespace exostra
                 parent->queueMessage(
                     Message::Event,
                     static_cast<MsgParam>(EventType::ChildTapped),
-                    getID()
+                    getHandle()
                 );
             }
             return parent != nullptr;
@@ -2759,6 +7124,8 @@ namespace exostra
             return true;
         }
 
+        bool isRecordable() const noexcept override { return true; }
+
         bool onDraw(MsgParam p1, MsgParam p2) override
         {
             auto theme = _getTheme();
@@ -2780,7 +7147,7 @@ namespace exostra
             );
             theme->drawText(
                 ctx,
-                getText().c_str(),
+                getText(),
                 DrawText::Single | DrawText::Center,
                 getClientRect(),
                 theme->getMetric(MetricID::DefTextSize).getUint8(),
@@ -2801,7 +7168,7 @@ namespace exostra
             EWM_ASSERT(theme);
             auto ctx = getGfxContext();
             EWM_ASSERT(ctx);
-            ctx->getTextBounds(getText().c_str(), rect.left, rect.top, &x, &y, &width, &height);
+            ctx->getTextBounds(getText(), rect.left, rect.top, &x, &y, &width, &height);
             const auto maxWidth = max(width, theme->getMetric(MetricID::DefButtonCX).getExtent());
             rect.right = rect.left + maxWidth +
                 (theme->getMetric(MetricID::ButtonLabelPadding).getExtent() * 2);
@@ -2819,6 +7186,8 @@ namespace exostra
         Label() = default;
         virtual ~Label() = default;
 
+        bool isRecordable() const noexcept override { return true; }
+
         bool onDraw(MsgParam p1, MsgParam p2) override
         {
             auto theme = _getTheme();
@@ -2828,7 +7197,7 @@ namespace exostra
             theme->drawWindowBackground(ctx, getClientRect(), getCornerRadius(), getBgColor());
             theme->drawText(
                 ctx,
-                getText().c_str(),
+                getText(),
                 DrawText::Single | DrawText::Ellipsis,
                 getClientRect(),
                 theme->getMetric(MetricID::DefTextSize).getUint8(),
@@ -2846,6 +7215,8 @@ namespace exostra
         MultilineLabel() = default;
         virtual ~MultilineLabel() = default;
 
+        bool isRecordable() const noexcept override { return true; }
+
         bool onDraw(MsgParam p1, MsgParam p2) override
         {
             auto theme = _getTheme();
@@ -2855,7 +7226,7 @@ namespace exostra
             theme->drawWindowBackground(ctx, getClientRect(), getCornerRadius(), getBgColor());
             theme->drawText(
                 ctx,
-                getText().c_str(),
+                getText(),
                 DrawText::Center,
                 getClientRect(),
                 theme->getMetric(MetricID::DefTextSize).getUint8(),
@@ -2934,14 +7305,14 @@ namespace exostra
             // the appropriate button metadata in their constructor
             bool first = true;
             uint8_t numButtons = 0;
-            forEachChild([&](const WindowPtr& child)
+            getChildren().forEach([&](const WindowPtr& child)
             {
                 if (bitsHigh(child->getStyle(), Style::Button)) {
                     numButtons++;
                 }
                 return true;
             });
-            forEachChild([&](const WindowPtr& child)
+            getChildren().forEach([&](const WindowPtr& child)
             {
                 if (!bitsHigh(child->getStyle(), Style::Button)) {
                     return true;
@@ -2983,7 +7354,9 @@ namespace exostra
                 case EventType::ChildTapped:
                     hide();
                     if (_callback) {
-                        _callback(static_cast<WindowID>(p2));
+                        auto wm    = _getWM();
+                        auto child = wm ? wm->getWindow(static_cast<WindowHandle>(p2)) : nullptr;
+                        _callback(child ? child->getID() : WID_INVALID);
                     }
                 return true;
                 default:
@@ -3072,13 +7445,15 @@ namespace exostra
         bool isChecked() const noexcept { return bitsHigh(getState(), State::Checked); }
 
     protected:
+        bool isRecordable() const noexcept override { return true; }
+
         bool onDraw(MsgParam p1, MsgParam p2) override
         {
             auto theme = _getTheme();
             EWM_ASSERT(theme);
             auto ctx = getGfxContext();
             EWM_ASSERT(ctx);
-            theme->drawCheckBox(ctx, getText().c_str(), isChecked(), getClientRect());
+            theme->drawCheckBox(ctx, getText(), isChecked(), getClientRect());
             return routeMessage(Message::PostDraw);
         }
 
@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2023-2024 Ryan M. Lederman <lederman@gmail.com>
+//
+// Banded rendering of overlapping windows: the rects flushed from the strip may
+// reach past the windows, and must not carry what was left there by other bands.
+#include "test_util.h"
+
+using namespace exostra;
+
+namespace
+{
+    struct Plain : Window
+    {
+        using Window::Window;
+    };
+
+    bool testOverlappingWindows()
+    {
+        auto display = std::make_shared<FbDisplay>("", 480, 320);
+        WindowManager::Config config;
+        config.renderMode = RenderMode::Banded;
+        auto wm = createWindowManager(display, std::make_shared<DefaultTheme>(),
+            getTestFont(), &config);
+        CHECK(wm && wm->begin(0));
+        const Rect rects[] = {
+            Rect(137, 5, 364, 87),
+            Rect(114, 54, 238, 149),
+            Rect(87, 2, 161, 91)
+        };
+        WindowID id = 1;
+        for (const auto& rect : rects) {
+            CHECK(wm->createWindow<Plain>(nullptr, id++, Style::Visible | Style::TopLevel,
+                rect.left, rect.top, rect.width(), rect.height()));
+        }
+        wm->render();
+        wm->setDirtyRect(wm->getDisplayRect());
+        wm->render();
+        wm->waitForFlush();
+        const auto fb = reinterpret_cast<const Color*>(display->getFramebuffer());
+        size_t stray = 0;
+        for (Coord y = 0; y < 320; y++) {
+            for (Coord x = 0; x < 480; x++) {
+                bool covered = false;
+                for (const auto& rect : rects) {
+                    covered = covered || (x >= rect.left && x < rect.right &&
+                        y >= rect.top && y < rect.bottom);
+                }
+                if (!covered && fb[(y * 480) + x] != 0) {
+                    stray++;
+                }
+            }
+        }
+        CHECK(stray == 0);
+        return true;
+    }
+} // namespace
+
+int main()
+{
+    const bool ok = testOverlappingWindows();
+    std::printf("%s\n", ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2023-2024 Ryan M. Lederman <lederman@gmail.com>
+//
+// Times the scalar and the vectorized pixel kernels over a 480x320 frame. The
+// runs are deliberately misaligned by one pixel, as spans usually are.
+#include "test_util.h"
+#include <vector>
+
+using namespace exostra;
+
+namespace
+{
+    constexpr size_t Pixels  = 480 * 320;
+    constexpr int Iterations = 200;
+
+    template<typename TRun>
+    uint32_t timeIt(TRun&& run)
+    {
+        const auto start = micros();
+        for (int iteration = 0; iteration < Iterations; iteration++) {
+            run(iteration);
+        }
+        return micros() - start;
+    }
+} // namespace
+
+int main()
+{
+    std::vector<Color> dst(Pixels + 1);
+    std::vector<Color> src(Pixels + 1);
+    for (size_t idx = 0; idx < src.size(); idx++) {
+        src[idx] = static_cast<Color>(idx * 2654435761U);
+    }
+    std::printf("%d iterations over %zu pixels (μs):\n", Iterations, Pixels);
+    std::printf("%-8s %10s %10s %10s %10s\n", "kernels", "fill", "copy", "swap", "blend");
+    for (const auto& kernels : { PixelKernels(), PixelKernels::getVectorized() }) {
+        const auto fill = timeIt([&](int iteration)
+        {
+            kernels.fill(dst.data() + 1, Pixels, static_cast<Color>(iteration));
+        });
+        const auto copy = timeIt([&](int)
+        {
+            kernels.copy(dst.data(), src.data() + 1, Pixels);
+        });
+        const auto swap = timeIt([&](int)
+        {
+            kernels.copySwapped(dst.data(), src.data() + 1, Pixels);
+        });
+        const auto blend = timeIt([&](int iteration)
+        {
+            kernels.blend(dst.data(), src.data() + 1, Pixels, static_cast<uint8_t>(iteration));
+        });
+        std::printf("%-8s %10u %10u %10u %10u\n", kernels.name, fill, copy, swap, blend);
+    }
+    std::printf("self-check: %s\n",
+        PixelKernels::selfCheck(PixelKernels::getVectorized()) ? "passed" : "FAILED");
+    return 0;
+}
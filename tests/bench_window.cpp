@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2023-2024 Ryan M. Lederman <lederman@gmail.com>
+//
+// Times the per-window checks that every render and hit test makes, which walk
+// the back-references from a window to its parent and the window manager.
+#include "test_util.h"
+#include <chrono>
+#include <vector>
+
+using namespace exostra;
+
+namespace
+{
+    struct Plain : Window
+    {
+        using Window::Window;
+    };
+
+    constexpr int Depth      = 4;
+    constexpr int Iterations = 1000000;
+
+    template<typename TRun>
+    double nsPerCall(TRun&& run)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (int iteration = 0; iteration < Iterations; iteration++) {
+            run();
+        }
+        const std::chrono::duration<double, std::nano> elapsed =
+            std::chrono::steady_clock::now() - start;
+        return elapsed.count() / Iterations;
+    }
+} // namespace
+
+int main()
+{
+    WindowManager::Config config;
+    config.renderMode = RenderMode::Direct;
+    auto wm = createWindowManager(std::make_shared<FbDisplay>("", 480, 320),
+        std::make_shared<DefaultTheme>(), getTestFont(), &config);
+    if (!wm || !wm->begin(0)) {
+        std::printf("failed to create the window manager\n");
+        return 1;
+    }
+    // A chain of nested windows; the innermost is Depth levels below the top.
+    std::vector<WindowPtr> chain;
+    chain.push_back(wm->createWindow<Plain>(nullptr, 1, Style::Visible | Style::TopLevel,
+        0, 0, 480, 320));
+    for (int level = 1; level <= Depth; level++) {
+        const Coord inset = static_cast<Coord>(level * 10);
+        chain.push_back(wm->createWindow<Plain>(chain.back(), WindowID(level + 1),
+            Style::Visible | Style::Child, inset, inset, 400 - inset, 240 - inset));
+    }
+    const auto& leaf = chain.back();
+    volatile bool sink = false;
+    std::printf("%d calls (ns per call):\n", Iterations);
+    std::printf("  isDrawable() at depth %d: %.1f\n", Depth, nsPerCall([&]()
+    {
+        sink = leaf->isDrawable();
+    }));
+    std::printf("  isDrawable() at the top:  %.1f\n", nsPerCall([&]()
+    {
+        sink = chain.front()->isDrawable();
+    }));
+    std::printf("  getClientRect():          %.1f\n", nsPerCall([&]()
+    {
+        sink = leaf->getClientRect().empty();
+    }));
+    return 0;
+}
@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2023-2024 Ryan M. Lederman <lederman@gmail.com>
+//
+// What Canvas16 draws must not depend on what was drawn before it (e.g. on which
+// arcs happen to be in the arc cache).
+#include "test_util.h"
+#include <initializer_list>
+#include <vector>
+
+using namespace exostra;
+
+namespace
+{
+    constexpr Extent Size = 28;
+
+    /** Draws rounded rects of the given radii, then returns a freshly drawn frame. */
+    std::vector<Color> drawFrameAfter(std::initializer_list<Coord> radii)
+    {
+        Canvas16 scratch(Size, Size);
+        for (const auto r : radii) {
+            scratch.fillRoundRect(0, 0, Size, Size, r, 0xffff);
+        }
+        Canvas16 canvas(Size, Size);
+        canvas.drawRoundFrame(2, 2, 24, 24, 10, 4, 0xffff);
+        return std::vector<Color>(canvas.getBuffer(), canvas.getBuffer() + (Size * Size));
+    }
+
+    bool testRoundFrameIgnoresArcCache()
+    {
+        // Fills the cache such that looking up the inner arc evicts the outer one.
+        const auto primed = drawFrameAfter({ 10, 1, 2, 3 });
+        // Evicts everything, so that both arcs are computed afresh.
+        const auto cold   = drawFrameAfter({ 20, 21, 22, 23 });
+        // Both arcs are cached.
+        const auto warm   = drawFrameAfter({});
+        CHECK(primed == cold);
+        CHECK(warm == cold);
+        // The outer corner is rounded: the top row starts further in than the sides.
+        CHECK(cold[(2 * Size) + 2] == 0 && cold[(2 * Size) + 13] == 0xffff);
+        CHECK(cold[(13 * Size) + 2] == 0xffff);
+        return true;
+    }
+} // namespace
+
+int main()
+{
+    const bool ok = testRoundFrameIgnoresArcCache();
+    std::printf("%s\n", ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2023-2024 Ryan M. Lederman <lederman@gmail.com>
+//
+// Children draw through a view of their parent's context: at any depth, a window
+// draws at its client rect (its own coordinates), and nothing it draws lands outside
+// of it.
+#include "test_util.h"
+
+using namespace exostra;
+
+namespace
+{
+    constexpr Color Marker = 0xf81f;
+
+    struct Plain : Window
+    {
+        using Window::Window;
+    };
+
+    /** Paints its client rect, and a margin around it that must be clipped away. */
+    struct Painter : Window
+    {
+        using Window::Window;
+
+        bool onDraw(MsgParam, MsgParam) override
+        {
+            const auto rect = getClientRect();
+            getGfxContext()->fillRect(rect.left - 10, rect.top - 10, rect.width() + 20,
+                rect.height() + 20, Marker);
+            return true;
+        }
+    };
+
+    Color pixelAt(const std::shared_ptr<FbDisplay>& display, Coord x, Coord y)
+    {
+        return reinterpret_cast<const Color*>(display->getFramebuffer())[(y * 480) + x];
+    }
+
+    bool testMode(RenderMode mode, const char* name)
+    {
+        std::printf("%s\n", name);
+        auto display = std::make_shared<FbDisplay>("", 480, 320);
+        WindowManager::Config config;
+        config.renderMode = mode;
+        auto wm = createWindowManager(display, std::make_shared<DefaultTheme>(),
+            getTestFont(), &config);
+        CHECK(wm && wm->begin(0));
+        auto top = wm->createWindow<Plain>(nullptr, 1, Style::Visible | Style::TopLevel,
+            20, 10, 440, 300);
+        CHECK(top);
+        auto child = wm->createWindow<Plain>(top, 2, Style::Visible | Style::Child,
+            100, 100, 200, 150);
+        CHECK(child);
+        auto grandchild = wm->createWindow<Painter>(child, 3, Style::Visible | Style::Child,
+            150, 140, 50, 40);
+        CHECK(grandchild);
+        CHECK(grandchild->getClientRect() == Rect(0, 0, 50, 40));
+        wm->render();
+        wm->waitForFlush();
+        CHECK(pixelAt(display, 150, 140) == Marker);
+        CHECK(pixelAt(display, 199, 179) == Marker);
+        CHECK(pixelAt(display, 149, 140) != Marker);
+        CHECK(pixelAt(display, 150, 139) != Marker);
+        CHECK(pixelAt(display, 200, 179) != Marker);
+        CHECK(pixelAt(display, 199, 180) != Marker);
+
+        // The view follows the window when it moves. Nothing re-paints where the
+        // window was, so only its new surroundings are checked.
+        grandchild->setRect(Rect(120, 110, 170, 150));
+        wm->setDirtyRect(grandchild->getRect());
+        wm->render();
+        wm->waitForFlush();
+        CHECK(pixelAt(display, 120, 110) == Marker);
+        CHECK(pixelAt(display, 169, 149) == Marker);
+        CHECK(pixelAt(display, 119, 110) != Marker);
+        CHECK(pixelAt(display, 120, 109) != Marker);
+        CHECK(pixelAt(display, 170, 130) != Marker);
+        CHECK(pixelAt(display, 130, 150) != Marker);
+        return true;
+    }
+} // namespace
+
+int main()
+{
+    bool ok = testMode(RenderMode::Retained, "retained");
+    ok = testMode(RenderMode::Panel, "panel") && ok;
+    ok = testMode(RenderMode::Shared, "shared") && ok;
+    ok = testMode(RenderMode::Banded, "banded") && ok;
+    ok = testMode(RenderMode::Direct, "direct") && ok;
+    std::printf("%s\n", ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2023-2024 Ryan M. Lederman <lederman@gmail.com>
+#include "test_util.h"
+#include <random>
+
+using namespace exostra;
+
+namespace
+{
+    constexpr Coord MaxCoord = 160;
+
+    bool overlaps(const Rect& a, const Rect& b)
+    {
+        return a.left < b.right && b.left < a.right && a.top < b.bottom && b.top < a.bottom;
+    }
+
+    bool contains(const DirtyRegion& region, Coord x, Coord y)
+    {
+        for (const auto& rect : region) {
+            if (x >= rect.left && x < rect.right && y >= rect.top && y < rect.bottom) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /** The rects must be disjoint, and cover everything that has been added. */
+    bool checkInvariants(const DirtyRegion& region, const std::vector<Rect>& added)
+    {
+        CHECK(region.size() <= DirtyRegion::Capacity);
+        for (size_t a = 0; a < region.size(); a++) {
+            for (size_t b = a + 1; b < region.size(); b++) {
+                CHECK(!overlaps(region[a], region[b]));
+            }
+        }
+        for (const auto& rect : added) {
+            for (Coord y = rect.top; y < rect.bottom; y++) {
+                for (Coord x = rect.left; x < rect.right; x++) {
+                    CHECK(contains(region, x, y));
+                }
+            }
+        }
+        return true;
+    }
+
+    bool testOverlapping()
+    {
+        // Used to split into a sliver that merged back into the rect it came from,
+        // forever.
+        DirtyRegion region;
+        const std::vector<Rect> added { Rect(39, 24, 103, 93), Rect(13, 91, 73, 133) };
+        for (const auto& rect : added) {
+            region.add(rect);
+        }
+        return checkInvariants(region, added);
+    }
+
+    bool testAdjacent()
+    {
+        DirtyRegion region;
+        CHECK(region.add(Rect(0, 0, 10, 10)));
+        CHECK(region.add(Rect(10, 0, 20, 10)));
+        CHECK(region.size() == 1 && region[0] == Rect(0, 0, 20, 10));
+        CHECK(region.add(Rect(0, 10, 20, 20)));
+        CHECK(region.size() == 1 && region[0] == Rect(0, 0, 20, 20));
+        CHECK(!region.add(Rect(5, 5, 15, 15)));
+        CHECK(!region.add(Rect(3, 3, 3, 9)));
+        return true;
+    }
+
+    bool testRandom()
+    {
+        std::mt19937 rng(1234);
+        std::uniform_int_distribution<int> coord(0, MaxCoord);
+        for (int round = 0; round < 2000; round++) {
+            DirtyRegion region;
+            std::vector<Rect> added;
+            const int count = 1 + (round % 12);
+            for (int idx = 0; idx < count; idx++) {
+                const Coord x0 = coord(rng);
+                const Coord y0 = coord(rng);
+                const Coord x1 = coord(rng);
+                const Coord y1 = coord(rng);
+                added.emplace_back(min(x0, x1), min(y0, y1), max(x0, x1), max(y0, y1));
+                region.add(added.back());
+                if (!checkInvariants(region, added)) {
+                    std::fprintf(stderr, "round %d, rect %d\n", round, idx);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+} // namespace
+
+int main()
+{
+    bool ok = true;
+    ok = testOverlapping() && ok;
+    ok = testAdjacent() && ok;
+    ok = testRandom() && ok;
+    std::printf("%s\n", ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}
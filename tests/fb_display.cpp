@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2023-2024 Ryan M. Lederman <lederman@gmail.com>
+//
+// FbDisplay only creates the file it maps when it stands in for a device (i.e. its
+// geometry was supplied); a missing device is an error, not a new file.
+#include "test_util.h"
+#include <string>
+
+using namespace exostra;
+
+namespace
+{
+    std::string tempPath(const char* name)
+    {
+        return "/tmp/exostra-test-" + std::to_string(getpid()) + "-" + name;
+    }
+
+    bool exists(const std::string& path)
+    {
+        struct stat st {};
+        return stat(path.c_str(), &st) == 0;
+    }
+
+    bool testMissingDevice()
+    {
+        const auto path = tempPath("fb0");
+        FbDisplay display(path.c_str());
+        CHECK(!display.begin());
+        CHECK(!exists(path));
+        return true;
+    }
+
+    bool testFileBacked()
+    {
+        const auto path = tempPath("fb.bin");
+        bool ok = false;
+        {
+            FbDisplay display(path.c_str(), 48, 32);
+            ok = display.begin() && display.getFramebuffer() != nullptr &&
+                display.width() == 48 && display.height() == 32;
+        }
+        struct stat st {};
+        ok = ok && stat(path.c_str(), &st) == 0 && st.st_size == 48 * 32 * 2;
+        unlink(path.c_str());
+        CHECK(ok);
+        return true;
+    }
+} // namespace
+
+int main()
+{
+    bool ok = true;
+    ok = testMissingDevice() && ok;
+    ok = testFileBacked() && ok;
+    std::printf("%s\n", ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}
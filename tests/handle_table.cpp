@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2023-2024 Ryan M. Lederman <lederman@gmail.com>
+//
+// Window creation must never fail under churn (however many windows have been
+// created before), and a destroyed window's handle must not resolve to a newer
+// window until every slot of the handle table has been reused.
+#include "test_util.h"
+#include <vector>
+
+using namespace exostra;
+
+namespace
+{
+    struct Plain : Window
+    {
+        using Window::Window;
+    };
+
+    /** Direct mode needs no off-screen pixels, so this also runs with static pools. */
+    WindowManagerPtr createTestWindowManager()
+    {
+        WindowManager::Config config;
+        config.renderMode = RenderMode::Direct;
+        return createWindowManager(std::make_shared<FbDisplay>("", 480, 320),
+            std::make_shared<DefaultTheme>(), getTestFont(), &config);
+    }
+
+    bool testChurn()
+    {
+        auto wm = createTestWindowManager();
+        CHECK(wm && wm->begin(0));
+        auto top = wm->createWindow<Plain>(nullptr, 1, Style::Visible | Style::TopLevel,
+            0, 0, 480, 320);
+        CHECK(top);
+        // More creations than there are handles, so that every generation wraps.
+        const size_t rounds = 3U * 0x10000U;
+        // The round in which each handle was last issued. With one other live window,
+        // the child cycles through Capacity - 1 slots.
+        std::vector<size_t> issued(0x10000U, SIZE_MAX);
+        const size_t minReuse = (HandleTable::Capacity - 1U) * HandleTable::MaxGeneration;
+        for (size_t round = 0; round < rounds; round++) {
+            auto child = wm->createWindow<Plain>(top, 2, Style::Child | Style::Visible,
+                10, 10, 20, 20);
+            CHECK(child);
+            const auto handle = child->getHandle();
+            CHECK(wm->getWindow(handle) == child);
+            CHECK(issued[handle] == SIZE_MAX || round - issued[handle] >= minReuse);
+            issued[handle] = round;
+            CHECK(child->destroy());
+            CHECK(top->removeChildByID(2));
+            CHECK(!wm->getWindow(handle));
+        }
+        CHECK(wm->getWindow(top->getHandle()) == top);
+        return true;
+    }
+
+    bool testCapacity()
+    {
+        auto wm = createTestWindowManager();
+        CHECK(wm && wm->begin(0));
+        // Fifteen children per top-level window, which fits the static child lists.
+        WindowPtr top;
+        for (WindowID id = 1; id <= HandleTable::Capacity; id++) {
+            const bool newTop = (id - 1) % 16 == 0;
+            auto win = newTop
+                ? wm->createWindow<Plain>(nullptr, id, Style::TopLevel, 0, 0, 1, 1)
+                : wm->createWindow<Plain>(top, id, Style::Child, 0, 0, 1, 1);
+            CHECK(win);
+            if (newTop) {
+                top = win;
+            }
+        }
+        CHECK(!wm->createWindow<Plain>(top, WindowID(HandleTable::Capacity + 1U),
+            Style::Child, 0, 0, 1, 1));
+        return true;
+    }
+} // namespace
+
+int main()
+{
+    bool ok = true;
+    ok = testChurn() && ok;
+    ok = testCapacity() && ok;
+    std::printf("%s\n", ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2023-2024 Ryan M. Lederman <lederman@gmail.com>
+//
+// The vectorized pixel kernels must produce the same pixels as the scalar ones, and
+// the self-check that decides which set is used must notice when they do not.
+#include "test_util.h"
+
+using namespace exostra;
+
+namespace
+{
+    bool testSelfCheck()
+    {
+        CHECK(PixelKernels::selfCheck(PixelKernels()));
+        const auto vectorized = PixelKernels::getVectorized();
+# if defined(EWM_SIMD_SSE2) || defined(EWM_SIMD_NEON)
+        CHECK(std::strcmp(vectorized.name, "scalar") != 0);
+# endif
+        CHECK(PixelKernels::selfCheck(vectorized));
+        CHECK(std::strcmp(PixelKernels::get().name, vectorized.name) == 0);
+        return true;
+    }
+
+    bool testBrokenKernelRejected()
+    {
+        auto broken = PixelKernels::getVectorized();
+        broken.copySwapped = [](Color* dst, const Color* src, size_t count)
+        {
+            std::memcpy(dst, src, count * sizeof(Color));
+        };
+        CHECK(!PixelKernels::selfCheck(broken));
+        broken = PixelKernels::getVectorized();
+        broken.fill = [](Color* dst, size_t count, Color color)
+        {
+            for (size_t idx = 0; idx < count; idx++) {
+                dst[idx] = idx == 16 ? 0 : color;
+            }
+        };
+        CHECK(!PixelKernels::selfCheck(broken));
+        return true;
+    }
+
+    bool testBlend()
+    {
+        const auto& kernels = PixelKernels::get();
+        Color dst = 0x0000;
+        Color src = 0xffff;
+        kernels.blend(&dst, &src, 1, 255);
+        CHECK(dst == 0xffff);
+        dst = 0xffff;
+        src = 0x0000;
+        kernels.blend(&dst, &src, 1, 0);
+        CHECK(dst == 0xffff);
+        return true;
+    }
+} // namespace
+
+int main()
+{
+    bool ok = true;
+    ok = testSelfCheck() && ok;
+    ok = testBrokenKernelRejected() && ok;
+    ok = testBlend() && ok;
+    std::printf("%s (%s)\n", ok ? "passed" : "FAILED", PixelKernels::get().name);
+    return ok ? 0 : 1;
+}
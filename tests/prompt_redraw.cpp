@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2023-2024 Ryan M. Lederman <lederman@gmail.com>
+//
+// Re-showing a hidden top-level window that has its own buffer must not re-draw it:
+// the buffer still holds the window, so showing it is only a flush.
+#include "test_util.h"
+
+using namespace exostra;
+
+namespace
+{
+    struct Plain : Window
+    {
+        using Window::Window;
+    };
+
+    bool testReshowPrompt()
+    {
+        auto display = std::make_shared<FbDisplay>("", 480, 320);
+        WindowManager::Config config;
+        config.renderMode = RenderMode::Retained;
+        auto wm = createWindowManager(display, std::make_shared<DefaultTheme>(),
+            getTestFont(), &config);
+        CHECK(wm && wm->begin(0));
+        CHECK(wm->createWindow<Plain>(nullptr, 1, Style::Visible | Style::TopLevel,
+            0, 0, 480, 320));
+        const std::deque<Prompt::ButtonInfo> buttons { { 100, "OK" }, { 101, "Cancel" } };
+        auto prompt = wm->createPrompt<Prompt>(nullptr, 2, Style::Prompt, "Hello there",
+            buttons, [](WindowID) {});
+        CHECK(prompt);
+        wm->render();
+        auto draws = wm->getDrawCount();
+        CHECK(prompt->show());
+        wm->render();
+        const auto firstShow = wm->getDrawCount() - draws;
+        CHECK(firstShow > 0);
+        const auto shown = std::vector<Color>(
+            reinterpret_cast<const Color*>(display->getFramebuffer()),
+            reinterpret_cast<const Color*>(display->getFramebuffer()) + (480 * 320));
+        draws = wm->getDrawCount();
+        CHECK(prompt->hide());
+        wm->render();
+        const auto hide = wm->getDrawCount() - draws;
+        draws = wm->getDrawCount();
+        CHECK(prompt->show());
+        wm->render();
+        const auto reshow = wm->getDrawCount() - draws;
+        std::printf("draws: first show %u, hide %u, re-show %u\n", firstShow, hide, reshow);
+        // What was under the prompt is still in the background window's buffer too.
+        CHECK(hide == 0);
+        CHECK(reshow == 0);
+        CHECK(std::equal(shown.begin(), shown.end(),
+            reinterpret_cast<const Color*>(display->getFramebuffer())));
+        return true;
+    }
+} // namespace
+
+int main()
+{
+    const bool ok = testReshowPrompt();
+    std::printf("%s\n", ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2023-2024 Ryan M. Lederman <lederman@gmail.com>
+//
+// Region must stay disjoint and YX-banded whatever is combined into it, including
+// when a result needs more rects than it can hold.
+#include "test_util.h"
+#include <random>
+
+using namespace exostra;
+
+namespace
+{
+    bool isValid(const Region& region)
+    {
+        for (size_t idx = 0; idx < region.size(); idx++) {
+            const auto& rect = region[idx];
+            CHECK(rect.right > rect.left && rect.bottom > rect.top);
+            for (size_t other = idx + 1; other < region.size(); other++) {
+                const auto& next = region[other];
+                CHECK(next.left >= rect.right || rect.left >= next.right ||
+                    next.top >= rect.bottom || rect.top >= next.bottom);
+                // Sorted by top, then left; a band's rects share their edges.
+                CHECK(next.top > rect.top ||
+                    (next.top == rect.top && next.bottom == rect.bottom &&
+                    next.left >= rect.right));
+            }
+        }
+        return true;
+    }
+
+    bool covers(const Region& region, const Rect& rect)
+    {
+        return region.contains(rect);
+    }
+
+    size_t area(const Region& region)
+    {
+        size_t total = 0;
+        for (const auto& rect : region) {
+            total += static_cast<size_t>(rect.width()) * rect.height();
+        }
+        return total;
+    }
+
+    bool testExact()
+    {
+        Region region(Rect(0, 0, 10, 10));
+        region.unite(Rect(5, 5, 15, 15));
+        CHECK(isValid(region));
+        CHECK(area(region) == 175);
+        region.subtract(Rect(0, 0, 15, 15));
+        CHECK(region.empty());
+        return true;
+    }
+
+    bool testOverflow()
+    {
+        // A checkerboard needs a rect per square, far more than fit.
+        Region board;
+        std::vector<Rect> squares;
+        for (Coord row = 0; row < 12; row++) {
+            for (Coord col = (row & 1); col < 12; col += 2) {
+                squares.push_back(Rect(col * 10, row * 10, (col + 1) * 10, (row + 1) * 10));
+                board.unite(squares.back());
+                CHECK(isValid(board));
+            }
+        }
+        CHECK(board.size() <= Region::Capacity);
+        for (const auto& square : squares) {
+            CHECK(covers(board, square));
+        }
+        // Cutting holes into the result, and intersecting it, keeps it valid.
+        board.subtract(Rect(15, 15, 25, 95));
+        CHECK(isValid(board));
+        board.intersect(Region(Rect(0, 0, 60, 60)));
+        CHECK(isValid(board));
+        return true;
+    }
+
+    bool testRandom()
+    {
+        std::mt19937 rng(4321);
+        std::uniform_int_distribution<int> coord(0, 200);
+        for (int round = 0; round < 200; round++) {
+            Region region;
+            for (int step = 0; step < 40; step++) {
+                const int x0 = coord(rng), x1 = coord(rng), y0 = coord(rng), y1 = coord(rng);
+                const Rect rect(min(x0, x1), min(y0, y1), max(x0, x1) + 1, max(y0, y1) + 1);
+                switch (step % 3) {
+                    case 0:
+                    case 1:
+                        region.unite(rect);
+                        CHECK(covers(region, rect));
+                        break;
+                    default:
+                        region.subtract(rect);
+                        break;
+                }
+                CHECK(isValid(region));
+            }
+        }
+        return true;
+    }
+} // namespace
+
+int main()
+{
+    bool ok = true;
+    ok = testExact() && ok;
+    ok = testOverflow() && ok;
+    ok = testRandom() && ok;
+    std::printf("%s\n", ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}
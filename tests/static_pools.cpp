@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2023-2024 Ryan M. Lederman <lederman@gmail.com>
+//
+// With EWM_STATIC_POOLS, nothing may be allocated from the heap once begin() has
+// returned: windows are created, rendered and destroyed (several times over) in the
+// render mode given by EWM_TEST_RENDER_MODE, while operator new counts its calls.
+// Then a child window is created and destroyed thousands of times, which must
+// neither fail nor allocate.
+#include "test_util.h"
+#include <cstdlib>
+#include <new>
+
+using namespace exostra;
+
+namespace
+{
+    bool counting    = false;
+    size_t allocated = 0;
+
+    struct Plain : Window
+    {
+        using Window::Window;
+    };
+
+    bool testNoHeapAfterBegin()
+    {
+        auto display = std::make_shared<FbDisplay>("", 480, 320);
+        WindowManager::Config config;
+        config.minHitTestIntervalMsec = 0;
+        config.renderMode             = RenderMode::EWM_TEST_RENDER_MODE;
+        auto wm = createWindowManager(display, std::make_shared<DefaultTheme>(),
+            getTestFont(), &config);
+        CHECK(wm);
+        // Constructed up front, as the caller would.
+        const std::deque<Prompt::ButtonInfo> buttons { { 100, "OK" } };
+        const Prompt::ResultCallback callback = [](WindowID) {};
+        CHECK(wm->begin(0));
+        counting = true;
+        for (int round = 0; round < 3; round++) {
+            auto win = wm->createWindow<Plain>(nullptr, 1, Style::Visible | Style::TopLevel,
+                0, 0, 480, 320);
+            auto progress = wm->createProgressBar<ProgressBar>(win, 2,
+                Style::Progress | Style::Child | Style::Visible, 10, 10, 460, 30,
+                ProgressStyle::Normal);
+            auto check = wm->createWindow<CheckBox>(win, 3,
+                Style::CheckBox | Style::Child | Style::Visible, 10, 280, 100, 30, "Check");
+            auto button = wm->createWindow<Button>(win, 4,
+                Style::Button | Style::Child | Style::Visible | Style::AutoSize, 10, 100, 0, 0,
+                "A button with a long label text");
+            auto win2 = wm->createWindow<Plain>(nullptr, 5,
+                Style::Visible | Style::TopLevel | Style::Frame, 300, 150, 150, 120);
+            auto label = wm->createWindow<Label>(win2, 6,
+                Style::Label | Style::Child | Style::Visible, 310, 160, 120, 30, "Label text");
+            auto prompt = wm->createPrompt<Prompt>(nullptr, 7, Style::Prompt,
+                "Hello there, this is a long prompt", buttons, callback);
+            CHECK(win && progress && check && button && win2 && label && prompt);
+            for (int i = 0; i < 5; i++) {
+                progress->setProgressValue(10.0f * i);
+                label->setText((i & 1) != 0 ? "odd" : "even");
+                wm->render();
+                wm->waitForFlush();
+            }
+            prompt->show();
+            wm->render();
+            wm->hitTest(240, 160);
+            wm->render();
+            prompt->hide();
+            wm->render();
+            wm->setForegroundWindow(win2);
+            wm->render();
+            wm->waitForFlush();
+            wm->tearDown();
+        }
+        // Weeks of uptime: a dialog whose child comes and goes, many more times than
+        // there are window handles per generation.
+        auto dialog = wm->createWindow<Plain>(nullptr, 1,
+            Style::Visible | Style::TopLevel | Style::Frame, 100, 80, 280, 160);
+        CHECK(dialog);
+        for (int cycle = 0; cycle < 20000; cycle++) {
+            auto button = wm->createWindow<Button>(dialog, 2,
+                Style::Button | Style::Child | Style::Visible, 120, 100, 120, 40, "OK");
+            if (!button) {
+                std::fprintf(stderr, "window creation failed after %d cycles\n", cycle);
+            }
+            CHECK(button);
+            if (cycle % 200 == 0) {
+                wm->render();
+                wm->waitForFlush();
+            }
+            CHECK(button->destroy());
+            CHECK(dialog->removeChildByID(2));
+        }
+        wm->render();
+        wm->waitForFlush();
+        wm->tearDown();
+        dialog.reset();
+        counting = false;
+        CHECK(getWindowPool().available() == WindowPool::Count);
+        if (allocated != 0) {
+            std::fprintf(stderr, "operator new called %zu time(s) after begin()\n", allocated);
+        }
+        CHECK(allocated == 0);
+        return true;
+    }
+} // namespace
+
+void* operator new(size_t size)
+{
+    if (counting) {
+        allocated++;
+    }
+    if (void* ptr = std::malloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+int main()
+{
+    const bool ok = testNoHeapAfterBegin();
+    std::printf("%s\n", ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}
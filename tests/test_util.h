@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2023-2024 Ryan M. Lederman <lederman@gmail.com>
+//
+// Shared by the host tests.
+#ifndef _EXOSTRA_TEST_UTIL_H_INCLUDED
+# define _EXOSTRA_TEST_UTIL_H_INCLUDED
+
+# include "exostra.h"
+# include <cstdio>
+
+/** Prints the failed expression and returns false from the calling test. */
+# define CHECK(expr) \
+    do { \
+        if (!(expr)) { \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr); \
+            return false; \
+        } \
+    } while (false)
+
+/** Returns a font in which every printable glyph is a solid 5x7 block. */
+inline GFXfont* getTestFont()
+{
+    static GFXglyph glyphs[0x7e - 0x20 + 1];
+    static uint8_t bitmap[] = { 0xff, 0xff, 0xff, 0xff, 0xff };
+    static GFXfont font = { bitmap, glyphs, 0x20, 0x7e, 10 };
+    for (auto& glyph : glyphs) {
+        glyph = { 0, 5, 7, 6, 0, -7 };
+    }
+    return &font;
+}
+
+#endif // !_EXOSTRA_TEST_UTIL_H_INCLUDED
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2023-2024 Ryan M. Lederman <lederman@gmail.com>
+//
+// Windows hold non-owning pointers to their window manager and parent. Windows
+// that the application holds on to must remain safe to use (if inert) after
+// they, or the window manager, are gone. Built with AddressSanitizer where
+// available.
+#include "test_util.h"
+
+using namespace exostra;
+
+namespace
+{
+    struct Plain : Window
+    {
+        using Window::Window;
+    };
+
+    bool checkInert(const WindowPtr& win)
+    {
+        CHECK(win->getHandle() == WH_INVALID);
+        CHECK(!win->isDrawable());
+        CHECK(!win->show());
+        CHECK(!win->redraw(true));
+        win->hide();
+        win->setRect(Rect(1, 2, 30, 40));
+        win->setStyle(win->getStyle() | Style::Frame);
+        CHECK(win->getClientRect() == Rect(0, 0, 29, 38));
+        CHECK(win->destroy());
+        return true;
+    }
+
+    bool testOutliveWindowManager()
+    {
+        WindowPtr top;
+        WindowPtr child;
+        {
+            auto wm = createWindowManager(std::make_shared<FbDisplay>("", 480, 320),
+                std::make_shared<DefaultTheme>(), getTestFont());
+            CHECK(wm && wm->begin(0));
+            top = wm->createWindow<Plain>(nullptr, 1, Style::Visible | Style::TopLevel,
+                0, 0, 480, 320);
+            child = wm->createWindow<Plain>(top, 2, Style::Visible | Style::Child,
+                10, 10, 100, 100);
+            CHECK(top && child && child->isDrawable());
+            wm->render();
+        }
+        CHECK(!top->getParent() && !child->getParent());
+        CHECK(checkInert(child));
+        CHECK(checkInert(top));
+        return true;
+    }
+
+    bool testOutliveParent()
+    {
+        auto wm = createWindowManager(std::make_shared<FbDisplay>("", 480, 320),
+            std::make_shared<DefaultTheme>(), getTestFont());
+        CHECK(wm && wm->begin(0));
+        auto top = wm->createWindow<Plain>(nullptr, 1, Style::Visible | Style::TopLevel,
+            0, 0, 480, 320);
+        auto child = wm->createWindow<Plain>(top, 2, Style::Visible | Style::Child,
+            10, 10, 100, 100);
+        CHECK(top && child);
+        wm->tearDown();
+        top.reset();
+        CHECK(!child->getParent());
+        CHECK(checkInert(child));
+        wm->render();
+        return true;
+    }
+} // namespace
+
+int main()
+{
+    bool ok = true;
+    ok = testOutliveWindowManager() && ok;
+    ok = testOutliveParent() && ok;
+    std::printf("%s\n", ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}